@@ -7,6 +7,9 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <cstdint>
+#include <cerrno>
+#include <sys/stat.h>
 
 std::string readFileContents(std::string path) {
     std::ifstream in(path);
@@ -15,5 +18,53 @@ std::string readFileContents(std::string path) {
     return buffer.str();
 }
 
+// 64-bit FNV-1a; pass the previous result as seed to hash several buffers as one key.
+inline uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t hash = seed;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+inline uint64_t hashString(const std::string& s, uint64_t seed = 14695981039346656037ull) {
+    return hashBytes(s.data(), s.size(), seed);
+}
+
+// modification time and size of a file, used to key on-disk caches to their source
+struct FileStamp {
+    int64_t mtime = 0;
+    int64_t mtimeNsec = 0;
+    uint64_t size = 0;
+};
+
+inline bool getFileStamp(const std::string& path, FileStamp& stamp) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    stamp.mtime = st.st_mtim.tv_sec;
+    stamp.mtimeNsec = st.st_mtim.tv_nsec;
+    stamp.size = st.st_size;
+    return true;
+}
+
+// mkdir -p
+inline bool createDirectories(const std::string& path) {
+    for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+        std::string prefix = path.substr(0, pos);
+        if (!prefix.empty() && mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+        if (pos == std::string::npos)
+            return true;
+    }
+}
+
+// root of all generated caches (mesh, texture, shader); relative to the working directory like the other resources
+inline std::string cacheDirectory() {
+    return "resources/cache";
+}
+
 
 #endif //PROJECT_BASE_COMMON_H
@@ -0,0 +1,110 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+
+// Axis-aligned box; the default one is empty (min > max) and grows with Expand.
+struct BoundingBox {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    bool Empty() const
+    {
+        return min.x > max.x || min.y > max.y || min.z > max.z;
+    }
+
+    void Expand(const glm::vec3 &point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void Expand(const BoundingBox &box)
+    {
+        if (box.Empty())
+            return;
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+
+    glm::vec3 Center() const { return (min + max) * 0.5f; }
+    // half the size along each axis
+    glm::vec3 Extents() const { return (max - min) * 0.5f; }
+
+    // the box around this one after an affine transform (Arvo): the center moves, the extents go through |M|
+    BoundingBox Transformed(const glm::mat4 &transform) const
+    {
+        if (Empty())
+            return *this;
+        glm::vec3 center = glm::vec3(transform * glm::vec4(Center(), 1.0f));
+        glm::vec3 extents = Extents();
+        glm::vec3 worldExtents(0.0f);
+        for (int column = 0; column < 3; column++)
+            worldExtents = worldExtents + glm::abs(glm::vec3(transform[column])) * extents[column];
+        BoundingBox box;
+        box.min = center - worldExtents;
+        box.max = center + worldExtents;
+        return box;
+    }
+};
+
+struct BoundingSphere {
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+
+    // the sphere after an affine transform; non-uniform scales grow it by the largest axis scale
+    BoundingSphere Transformed(const glm::mat4 &transform) const
+    {
+        BoundingSphere sphere;
+        sphere.center = glm::vec3(transform * glm::vec4(center, 1.0f));
+        float scale = 0.0f;
+        for (int column = 0; column < 3; column++)
+            scale = std::max(scale, glm::length(glm::vec3(transform[column])));
+        sphere.radius = radius * scale;
+        return sphere;
+    }
+};
+
+// The bounds of a mesh in its own space. The sphere is centered on the box, so a culler can keep one center and
+// test against whichever of the two is tighter for a plane.
+struct MeshBounds {
+    BoundingBox box;
+    BoundingSphere sphere;
+
+    bool Empty() const { return box.Empty(); }
+
+    MeshBounds Transformed(const glm::mat4 &transform) const
+    {
+        MeshBounds bounds;
+        bounds.box = box.Transformed(transform);
+        bounds.sphere = sphere.Transformed(transform);
+        return bounds;
+    }
+};
+
+// bounds of count positions, `stride` bytes apart (e.g. &vertices[0].Position, sizeof(Vertex))
+inline MeshBounds ComputeBounds(const glm::vec3 *positions, size_t count, size_t stride)
+{
+    MeshBounds bounds;
+    const unsigned char *bytes = reinterpret_cast<const unsigned char*>(positions);
+    for (size_t i = 0; i < count; i++)
+        bounds.box.Expand(*reinterpret_cast<const glm::vec3*>(bytes + i * stride));
+    if (bounds.box.Empty())
+        return bounds;
+    // the farthest point from the box center: never looser than the half diagonal, usually tighter
+    bounds.sphere.center = bounds.box.Center();
+    float radiusSquared = 0.0f;
+    for (size_t i = 0; i < count; i++)
+    {
+        glm::vec3 offset = *reinterpret_cast<const glm::vec3*>(bytes + i * stride) - bounds.sphere.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    bounds.sphere.radius = std::sqrt(radiusSquared);
+    return bounds;
+}
+#endif
@@ -0,0 +1,499 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bounds.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cstdint>
+#include <deque>
+#include <numeric>
+#include <vector>
+
+struct BVHNode {
+    BoundingBox box;
+    // inner node: index of the left child, the right one follows it; leaf: first of its entries in BVH::Objects()
+    uint32_t first = 0;
+    // objects in a leaf, 0 for inner nodes
+    uint32_t count = 0;
+
+    bool Leaf() const { return count > 0; }
+};
+
+struct Ray {
+    glm::vec3 origin = glm::vec3(0.0f);
+    glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+};
+
+struct RayHit {
+    uint32_t object = UINT32_MAX;
+    float distance = FLT_MAX;
+};
+
+// slab test; inverseDirection is 1 / ray direction. distance is where the ray enters the box (0 if it starts inside).
+inline bool IntersectRayBox(const glm::vec3 &origin, const glm::vec3 &inverseDirection, const BoundingBox &box,
+                            float maxDistance, float &distance)
+{
+    float near = 0.0f, far = maxDistance;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float t0 = (box.min[axis] - origin[axis]) * inverseDirection[axis];
+        float t1 = (box.max[axis] - origin[axis]) * inverseDirection[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        near = std::max(near, t0);
+        far = std::min(far, t1);
+    }
+    distance = near;
+    return near <= far;
+}
+
+// Bounding volume hierarchy over the world boxes of a set of objects (e.g. model instances), for frustum culling
+// and ray picking in roughly logarithmic time.
+//
+// Build uses the surface area heuristic evaluated on BIN_COUNT bins per axis. The top of the tree is split on the
+// calling thread with the binning of large nodes spread over the pool; once there are enough independent subtrees
+// they are built in parallel. Refit keeps the tree and only recomputes the node boxes, which is enough when objects
+// move a little; after large moves a rebuild gives faster queries again.
+class BVH
+{
+public:
+    static const unsigned int BIN_COUNT = 16;
+    static const unsigned int MAX_LEAF_SIZE = 4;
+
+    // builds over boxes[i] as object i; boxes must not be empty. Without a pool everything runs on this thread.
+    void Build(const std::vector<BoundingBox> &boxes, ThreadPool *pool = &ThreadPool::Shared())
+    {
+        size_t count = boxes.size();
+        source = &boxes;
+        objects.resize(count);
+        std::iota(objects.begin(), objects.end(), 0u);
+        centroids.resize(count);
+        forChunks(pool, count, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                centroids[i] = boxes[i].Center();
+        });
+        nodes.assign(count > 0 ? 2 * count - 1 : 0, BVHNode());
+        nodeCount = count > 0 ? 1 : 0;
+
+        if (count > 0)
+        {
+            // split breadth first until there is a subtree for every thread, then build those in parallel
+            size_t wanted = pool ? 4 * (pool->Size() + 1) : 1;
+            std::deque<BuildTask> pending{BuildTask{0, 0, (uint32_t) count}};
+            std::vector<BuildTask> subtrees;
+            while (!pending.empty() && pending.size() + subtrees.size() < wanted)
+            {
+                BuildTask task = pending.front();
+                pending.pop_front();
+                if (task.end - task.begin < PARALLEL_SUBTREE_SIZE)
+                {
+                    subtrees.push_back(task);
+                    continue;
+                }
+                BuildTask left, right;
+                if (split(task, pool, left, right))
+                {
+                    pending.push_back(left);
+                    pending.push_back(right);
+                }
+            }
+            subtrees.insert(subtrees.end(), pending.begin(), pending.end());
+            auto buildSubtree = [&](size_t i) { build(subtrees[i]); };
+            if (pool)
+                pool->ParallelFor(subtrees.size(), buildSubtree);
+            else
+                for (size_t i = 0; i < subtrees.size(); i++)
+                    buildSubtree(i);
+        }
+        nodes.resize(nodeCount);
+        centroids.clear();
+        centroids.shrink_to_fit();
+
+        objectBoxes.resize(count);
+        for (size_t i = 0; i < count; i++)
+            objectBoxes[i] = boxes[objects[i]];
+        source = nullptr;
+    }
+
+    // the same objects at new boxes (boxes[i] is still object i): recomputes the node boxes bottom up
+    void Refit(const std::vector<BoundingBox> &boxes)
+    {
+        for (size_t i = 0; i < objects.size(); i++)
+            objectBoxes[i] = boxes[objects[i]];
+        // children are always allocated after their parent, so walking backwards visits them first
+        for (size_t i = nodes.size(); i-- > 0; )
+        {
+            BVHNode &node = nodes[i];
+            node.box = BoundingBox();
+            if (node.Leaf())
+            {
+                for (uint32_t j = node.first; j < node.first + node.count; j++)
+                    node.box.Expand(objectBoxes[j]);
+            }
+            else
+            {
+                node.box.Expand(nodes[node.first].box);
+                node.box.Expand(nodes[node.first + 1].box);
+            }
+        }
+    }
+
+    // the objects whose boxes are not entirely outside the frustum, in no particular order
+    void QueryFrustum(const Frustum &frustum, std::vector<uint32_t> &result) const
+    {
+        result.clear();
+        if (nodes.empty())
+            return;
+        // each entry carries the planes its box is not yet known to be inside of
+        struct Entry {
+            uint32_t node;
+            uint32_t planes;
+        };
+        std::vector<Entry> stack;
+        stack.reserve(64);
+        stack.push_back({0, (1u << Frustum::PLANE_COUNT) - 1});
+        while (!stack.empty())
+        {
+            Entry entry = stack.back();
+            stack.pop_back();
+            const BVHNode &node = nodes[entry.node];
+            if (!classify(frustum, node.box, entry.planes))
+                continue;
+            if (!node.Leaf())
+            {
+                stack.push_back({node.first + 1, entry.planes});
+                stack.push_back({node.first, entry.planes});
+                continue;
+            }
+            for (uint32_t j = node.first; j < node.first + node.count; j++)
+            {
+                uint32_t planes = entry.planes;
+                if (planes == 0 || classify(frustum, objectBoxes[j], planes))
+                    result.push_back(objects[j]);
+            }
+        }
+    }
+
+    // the nearest object whose box the ray hits within maxDistance
+    bool Raycast(const Ray &ray, RayHit &hit, float maxDistance = FLT_MAX) const
+    {
+        glm::vec3 inverseDirection = inverse(ray.direction);
+        return Raycast(ray, hit, maxDistance, [&](uint32_t, const BoundingBox &box, float closest, float &distance) {
+            return IntersectRayBox(ray.origin, inverseDirection, box, closest, distance);
+        });
+    }
+
+    // the nearest hit reported by intersect(object, box, closest, distance) for the objects whose boxes the ray
+    // reaches; intersect returns whether it hit something closer than `closest` and where. Lets callers refine
+    // the box hits, e.g. against the triangles of the object.
+    template<typename Intersect>
+    bool Raycast(const Ray &ray, RayHit &hit, float maxDistance, Intersect intersect) const
+    {
+        hit = RayHit();
+        hit.distance = maxDistance;
+        if (nodes.empty())
+            return false;
+        glm::vec3 inverseDirection = inverse(ray.direction);
+        float distance;
+        if (!IntersectRayBox(ray.origin, inverseDirection, nodes[0].box, hit.distance, distance))
+            return false;
+        std::vector<uint32_t> stack;
+        stack.reserve(64);
+        stack.push_back(0);
+        while (!stack.empty())
+        {
+            const BVHNode &node = nodes[stack.back()];
+            stack.pop_back();
+            // the hit may have moved closer since the node was pushed
+            if (!IntersectRayBox(ray.origin, inverseDirection, node.box, hit.distance, distance))
+                continue;
+            if (node.Leaf())
+            {
+                for (uint32_t j = node.first; j < node.first + node.count; j++)
+                {
+                    if (intersect(objects[j], objectBoxes[j], hit.distance, distance) && distance < hit.distance)
+                    {
+                        hit.object = objects[j];
+                        hit.distance = distance;
+                    }
+                }
+                continue;
+            }
+            // visit the nearer child first, so the farther one can be skipped if something closer is found
+            float leftDistance, rightDistance;
+            bool left = IntersectRayBox(ray.origin, inverseDirection, nodes[node.first].box, hit.distance, leftDistance);
+            bool right = IntersectRayBox(ray.origin, inverseDirection, nodes[node.first + 1].box, hit.distance, rightDistance);
+            if (left && right)
+            {
+                bool leftFirst = leftDistance <= rightDistance;
+                stack.push_back(leftFirst ? node.first + 1 : node.first);
+                stack.push_back(leftFirst ? node.first : node.first + 1);
+            }
+            else if (left || right)
+            {
+                stack.push_back(left ? node.first : node.first + 1);
+            }
+        }
+        return hit.object != UINT32_MAX;
+    }
+
+    void Clear()
+    {
+        nodes.clear();
+        objects.clear();
+        objectBoxes.clear();
+    }
+
+    bool Empty() const { return nodes.empty(); }
+    // node 0 is the root
+    const std::vector<BVHNode> &Nodes() const { return nodes; }
+    // object indices in leaf order; a leaf's objects are Objects()[first, first + count)
+    const std::vector<uint32_t> &Objects() const { return objects; }
+
+private:
+    // ranges smaller than this are built by a single thread; binning them in parallel isn't worth the handoff
+    static const uint32_t PARALLEL_SUBTREE_SIZE = 4096;
+    static const uint32_t PARALLEL_BINNING_SIZE = 65536;
+
+    struct BuildTask {
+        uint32_t node;
+        uint32_t begin, end;
+    };
+
+    struct Bin {
+        BoundingBox box;
+        uint32_t count = 0;
+    };
+
+    // all three axes' bins, plus the bounds of the range they were filled from
+    struct Binning {
+        Bin bins[3][BIN_COUNT];
+        BoundingBox box, centroidBox;
+    };
+
+    std::vector<BVHNode> nodes;
+    std::vector<uint32_t> objects;
+    // the boxes in leaf order (objectBoxes[j] belongs to objects[j])
+    std::vector<BoundingBox> objectBoxes;
+    // build state
+    const std::vector<BoundingBox> *source = nullptr;
+    std::vector<glm::vec3> centroids;
+    std::atomic<uint32_t> nodeCount{0};
+
+    static glm::vec3 inverse(const glm::vec3 &direction)
+    {
+        return glm::vec3(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    }
+
+    static float area(const BoundingBox &box)
+    {
+        if (box.Empty())
+            return 0.0f;
+        glm::vec3 size = box.max - box.min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    // false if the box is outside one of the planes; clears the bits of the planes it is entirely inside of
+    static bool classify(const Frustum &frustum, const BoundingBox &box, uint32_t &planes)
+    {
+        glm::vec3 center = box.Center(), extents = box.Extents();
+        for (int i = 0; i < Frustum::PLANE_COUNT; i++)
+        {
+            if (!(planes & (1u << i)))
+                continue;
+            const glm::vec4 &plane = frustum.planes[i];
+            glm::vec3 normal(plane);
+            float distance = glm::dot(normal, center) + plane.w;
+            float reach = glm::dot(glm::abs(normal), extents);
+            if (distance + reach < 0.0f)
+                return false;
+            if (distance - reach >= 0.0f)
+                planes &= ~(1u << i);
+        }
+        return true;
+    }
+
+    // fn(begin, end) over [0, count) in chunks, spread over the pool when there is enough work
+    template<typename Function>
+    static void forChunks(ThreadPool *pool, size_t count, Function fn)
+    {
+        if (!pool || count < PARALLEL_BINNING_SIZE)
+        {
+            fn(0, count);
+            return;
+        }
+        size_t chunks = pool->Size() + 1;
+        size_t chunkSize = (count + chunks - 1) / chunks;
+        pool->ParallelFor(chunks, [&](size_t chunk) {
+            fn(std::min(count, chunk * chunkSize), std::min(count, (chunk + 1) * chunkSize));
+        });
+    }
+
+    // builds the subtree of task on this thread
+    void build(const BuildTask &root)
+    {
+        std::vector<BuildTask> stack{root};
+        while (!stack.empty())
+        {
+            BuildTask task = stack.back();
+            stack.pop_back();
+            BuildTask left, right;
+            if (split(task, nullptr, left, right))
+            {
+                stack.push_back(right);
+                stack.push_back(left);
+            }
+        }
+    }
+
+    void bin(const BoundingBox &centroidBox, Binning &binning, uint32_t begin, uint32_t end) const
+    {
+        glm::vec3 extent = centroidBox.max - centroidBox.min;
+        for (uint32_t i = begin; i < end; i++)
+        {
+            uint32_t object = objects[i];
+            const glm::vec3 &centroid = centroids[object];
+            for (int axis = 0; axis < 3; axis++)
+            {
+                if (extent[axis] <= 0.0f)
+                    continue;
+                Bin &b = binning.bins[axis][binIndex(centroid[axis], centroidBox.min[axis], extent[axis])];
+                b.box.Expand((*source)[object]);
+                b.count++;
+            }
+        }
+    }
+
+    static uint32_t binIndex(float value, float min, float extent)
+    {
+        int index = (int) ((value - min) / extent * BIN_COUNT);
+        return (uint32_t) std::min(std::max(index, 0), (int) BIN_COUNT - 1);
+    }
+
+    // sets the node's box and either makes it a leaf (false) or splits its range at the cheapest bin boundary and
+    // allocates its children (true)
+    bool split(const BuildTask &task, ThreadPool *pool, BuildTask &left, BuildTask &right)
+    {
+        BVHNode &node = nodes[task.node];
+        uint32_t count = task.end - task.begin;
+
+        // one Binning per chunk forChunks makes; only the top nodes of a parallel build have more than one
+        Binning single;
+        Binning *parts = &single;
+        size_t partCount = 1;
+        std::vector<Binning> partial;
+        if (pool && count >= PARALLEL_BINNING_SIZE)
+        {
+            partial.resize(pool->Size() + 1);
+            parts = partial.data();
+            partCount = partial.size();
+        }
+
+        // bounds of the range and of its centroids
+        std::atomic<size_t> nextPartial{0};
+        forChunks(pool, count, [&](size_t begin, size_t end) {
+            Binning &b = parts[nextPartial.fetch_add(1)];
+            for (size_t i = task.begin + begin; i < task.begin + end; i++)
+            {
+                b.box.Expand((*source)[objects[i]]);
+                b.centroidBox.Expand(centroids[objects[i]]);
+            }
+        });
+        BoundingBox box, centroidBox;
+        for (size_t p = 0; p < partCount; p++)
+        {
+            box.Expand(parts[p].box);
+            centroidBox.Expand(parts[p].centroidBox);
+        }
+        node.box = box;
+        if (count <= MAX_LEAF_SIZE)
+        {
+            node.first = task.begin;
+            node.count = count;
+            return false;
+        }
+
+        // fill the bins, per chunk when in parallel, then merge
+        nextPartial = 0;
+        for (size_t p = 0; p < partCount; p++)
+            parts[p] = Binning();
+        forChunks(pool, count, [&](size_t begin, size_t end) {
+            bin(centroidBox, parts[nextPartial.fetch_add(1)], task.begin + begin, task.begin + end);
+        });
+        Binning &binning = parts[0];
+        for (size_t p = 1; p < partCount; p++)
+            for (int axis = 0; axis < 3; axis++)
+                for (unsigned int i = 0; i < BIN_COUNT; i++)
+                {
+                    binning.bins[axis][i].box.Expand(parts[p].bins[axis][i].box);
+                    binning.bins[axis][i].count += parts[p].bins[axis][i].count;
+                }
+
+        // sweep each axis: cost of splitting after bin i is area(left) * count(left) + area(right) * count(right)
+        int bestAxis = -1;
+        unsigned int bestSplit = 0;
+        float bestCost = FLT_MAX;
+        glm::vec3 extent = centroidBox.max - centroidBox.min;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (extent[axis] <= 0.0f)
+                continue;
+            const Bin *bins = binning.bins[axis];
+            float rightCost[BIN_COUNT];
+            BoundingBox rightBox;
+            uint32_t rightCount = 0;
+            for (unsigned int i = BIN_COUNT - 1; i > 0; i--)
+            {
+                rightBox.Expand(bins[i].box);
+                rightCount += bins[i].count;
+                rightCost[i] = area(rightBox) * rightCount;
+            }
+            BoundingBox leftBox;
+            uint32_t leftCount = 0;
+            for (unsigned int i = 1; i < BIN_COUNT; i++)
+            {
+                leftBox.Expand(bins[i - 1].box);
+                leftCount += bins[i - 1].count;
+                if (leftCount == 0 || leftCount == count)
+                    continue;
+                float cost = area(leftBox) * leftCount + rightCost[i];
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+
+        uint32_t middle;
+        if (bestAxis < 0)
+        {
+            // every centroid is at the same point: no plane separates them, so halve the range
+            middle = task.begin + count / 2;
+        }
+        else
+        {
+            float min = centroidBox.min[bestAxis], axisExtent = extent[bestAxis];
+            uint32_t *first = objects.data() + task.begin;
+            uint32_t *last = objects.data() + task.end;
+            middle = (uint32_t) (std::partition(first, last, [&](uint32_t object) {
+                return binIndex(centroids[object][bestAxis], min, axisExtent) < bestSplit;
+            }) - objects.data());
+        }
+
+        uint32_t children = nodeCount.fetch_add(2);
+        node.first = children;
+        node.count = 0;
+        left = BuildTask{children, task.begin, middle};
+        right = BuildTask{children + 1, middle, task.end};
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,128 @@
+#ifndef BVH_BENCHMARK_H
+#define BVH_BENCHMARK_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/bvh.h>
+#include <learnopengl/frustum.h>
+#include <learnopengl/thread_pool.h>
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// CPU-only timings of BVH builds, refits and queries over instanceCount random boxes, next to the linear
+// FrustumCuller for comparison. Boxes are spread at constant density so each query sees a similar share of them.
+inline void RunBVHBenchmark(const std::vector<size_t> &instanceCounts)
+{
+    typedef std::chrono::steady_clock Clock;
+    auto milliseconds = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+    const int FRUSTUM_QUERIES = 200;
+    const int RAY_QUERIES = 100000;
+
+    std::ios::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(10) << "instances" << std::setw(13) << "build 1T ms" << std::setw(13) << "build MT ms"
+              << std::setw(11) << "refit ms" << std::setw(15) << "frustum us/q" << std::setw(15) << "linear us/q"
+              << std::setw(13) << "Mrays/s" << std::endl;
+    for (size_t count : instanceCounts)
+    {
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        float side = 4.0f * std::cbrt((float) count);
+        std::vector<BoundingBox> boxes(count);
+        for (BoundingBox &box : boxes)
+        {
+            glm::vec3 center(unit(random) * side, unit(random) * side, unit(random) * side);
+            glm::vec3 extents = glm::vec3(0.25f) + glm::vec3(unit(random), unit(random), unit(random));
+            box.min = center - extents;
+            box.max = center + extents;
+        }
+
+        BVH bvh;
+        Clock::time_point start = Clock::now();
+        bvh.Build(boxes, nullptr);
+        double buildSingle = milliseconds(start);
+        start = Clock::now();
+        bvh.Build(boxes);
+        double buildParallel = milliseconds(start);
+
+        for (BoundingBox &box : boxes)
+        {
+            glm::vec3 offset = glm::vec3(unit(random), unit(random), unit(random)) - glm::vec3(0.5f);
+            box.min = box.min + offset;
+            box.max = box.max + offset;
+        }
+        start = Clock::now();
+        bvh.Refit(boxes);
+        double refit = milliseconds(start);
+
+        // cameras inside the volume looking at random points, seeing about a tenth of its depth
+        std::vector<Frustum> frustums;
+        for (int i = 0; i < FRUSTUM_QUERIES; i++)
+        {
+            glm::vec3 eye(unit(random) * side, unit(random) * side, unit(random) * side);
+            glm::vec3 target(unit(random) * side, unit(random) * side, unit(random) * side);
+            glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 0.1f * side + 10.0f);
+            frustums.push_back(Frustum(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f))));
+        }
+        std::vector<uint32_t> visible;
+        size_t visibleSum = 0;
+        start = Clock::now();
+        for (const Frustum &frustum : frustums)
+        {
+            bvh.QueryFrustum(frustum, visible);
+            visibleSum += visible.size();
+        }
+        double frustumQuery = milliseconds(start) * 1000.0 / FRUSTUM_QUERIES;
+
+        FrustumCuller culler;
+        for (const BoundingBox &box : boxes)
+        {
+            MeshBounds bounds;
+            bounds.box = box;
+            bounds.sphere.center = box.Center();
+            bounds.sphere.radius = glm::length(box.Extents());
+            culler.Add(bounds);
+        }
+        size_t linearSum = 0;
+        start = Clock::now();
+        for (const Frustum &frustum : frustums)
+        {
+            culler.SetFrustum(frustum);
+            linearSum += culler.Cull().size();
+        }
+        double linearQuery = milliseconds(start) * 1000.0 / FRUSTUM_QUERIES;
+
+        std::vector<Ray> rays(RAY_QUERIES);
+        for (Ray &ray : rays)
+        {
+            ray.origin = glm::vec3(unit(random) * side, unit(random) * side, unit(random) * side);
+            ray.direction = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) - glm::vec3(0.5f));
+        }
+        size_t hits = 0;
+        start = Clock::now();
+        for (const Ray &ray : rays)
+        {
+            RayHit hit;
+            hits += bvh.Raycast(ray, hit);
+        }
+        double rayRate = RAY_QUERIES / (milliseconds(start) * 1000.0);
+
+        std::cout << std::setw(10) << count << std::setw(13) << buildSingle << std::setw(13) << buildParallel
+                  << std::setw(11) << refit << std::setw(15) << frustumQuery << std::setw(15) << linearQuery
+                  << std::setw(13) << rayRate << std::endl;
+        std::cout << std::setw(10) << "" << " visible per query: " << visibleSum / FRUSTUM_QUERIES << " (linear "
+                  << linearSum / FRUSTUM_QUERIES << "), rays hitting: " << hits << " of " << RAY_QUERIES << std::endl;
+    }
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
+#endif
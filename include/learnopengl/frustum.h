@@ -0,0 +1,164 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bounds.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// The six planes of a projection * view matrix (Gribb/Hartmann), normalized and pointing inwards: a point p is
+// inside when dot(plane.xyz, p) + plane.w >= 0 for all of them.
+struct Frustum {
+    enum Plane { Left, Right, Bottom, Top, Near, Far, PLANE_COUNT };
+
+    glm::vec4 planes[PLANE_COUNT];
+
+    Frustum() = default;
+
+    explicit Frustum(const glm::mat4 &projectionView)
+    {
+        // glm is column-major: row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(projectionView[0][i], projectionView[1][i], projectionView[2][i], projectionView[3][i]);
+        planes[Left] = rows[3] + rows[0];
+        planes[Right] = rows[3] - rows[0];
+        planes[Bottom] = rows[3] + rows[1];
+        planes[Top] = rows[3] - rows[1];
+        planes[Near] = rows[3] + rows[2];
+        planes[Far] = rows[3] - rows[2];
+        for (glm::vec4 &plane : planes)
+            plane = plane / glm::length(glm::vec3(plane));
+    }
+
+    // false only if the box is entirely outside one of the planes (conservative near the frustum's corners)
+    bool Intersects(const BoundingBox &box) const
+    {
+        if (box.Empty())
+            return true;
+        glm::vec3 center = box.Center(), extents = box.Extents();
+        for (const glm::vec4 &plane : planes)
+        {
+            glm::vec3 normal(plane);
+            if (glm::dot(normal, center) + plane.w + glm::dot(glm::abs(normal), extents) < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+
+// what a FrustumCuller has tested since its stats were last reset
+struct CullStats {
+    size_t tested = 0;
+    size_t culled = 0;
+
+    size_t Visible() const { return tested - culled; }
+};
+
+// Tests a batch of world-space bounds against a frustum. The bounds are kept as structure of arrays, one array per
+// component, and each plane is tested against the whole batch in a branch-free loop the compiler vectorizes. Each
+// entry is a box with its bounding sphere around the same center; per plane the tighter of the two is used.
+//
+//     culler.SetFrustum(Frustum(projection * view));
+//     culler.Clear();
+//     for (...) culler.Add(bounds.Transformed(model));
+//     for (uint32_t i : culler.Cull()) draw(i);
+class FrustumCuller
+{
+public:
+    void SetFrustum(const Frustum &value)
+    {
+        frustum = value;
+    }
+
+    const Frustum &CurrentFrustum() const { return frustum; }
+
+    // empties the batch; storage is kept for the next one
+    void Clear()
+    {
+        centerX.clear(); centerY.clear(); centerZ.clear();
+        extentX.clear(); extentY.clear(); extentZ.clear();
+        radius.clear();
+    }
+
+    // appends world-space bounds and returns their index in the batch. Empty bounds (no geometry) are never culled.
+    uint32_t Add(const MeshBounds &bounds)
+    {
+        uint32_t index = (uint32_t) centerX.size();
+        if (bounds.Empty())
+        {
+            push(glm::vec3(0.0f), glm::vec3(FLT_MAX), FLT_MAX);
+            return index;
+        }
+        glm::vec3 extents = bounds.box.Extents();
+        push(bounds.box.Center(), extents, std::min(bounds.sphere.radius, glm::length(extents)));
+        return index;
+    }
+
+    uint32_t Size() const { return (uint32_t) centerX.size(); }
+
+    // indices of the entries of the batch that may be visible, in the order they were added
+    const std::vector<uint32_t> &Cull()
+    {
+        size_t count = centerX.size();
+        margin.assign(count, FLT_MAX);
+        for (const glm::vec4 &plane : frustum.planes)
+            testPlane(plane, count);
+
+        visible.clear();
+        for (size_t i = 0; i < count; i++)
+            if (margin[i] >= 0.0f)
+                visible.push_back((uint32_t) i);
+        stats.tested += count;
+        stats.culled += count - visible.size();
+        return visible;
+    }
+
+    CullStats Stats() const { return stats; }
+    void ResetStats() { stats = CullStats(); }
+
+private:
+    Frustum frustum;
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+    std::vector<float> radius;
+    // per entry, the least signed distance + reach over the planes tested so far; negative once it is outside one
+    std::vector<float> margin;
+    std::vector<uint32_t> visible;
+    CullStats stats;
+
+    void push(const glm::vec3 &center, const glm::vec3 &extents, float sphereRadius)
+    {
+        centerX.push_back(center.x); centerY.push_back(center.y); centerZ.push_back(center.z);
+        extentX.push_back(extents.x); extentY.push_back(extents.y); extentZ.push_back(extents.z);
+        radius.push_back(sphereRadius);
+    }
+
+    void testPlane(const glm::vec4 &plane, size_t count)
+    {
+        const float nx = plane.x, ny = plane.y, nz = plane.z, d = plane.w;
+        const float ax = std::fabs(nx), ay = std::fabs(ny), az = std::fabs(nz);
+        const float *__restrict cx = centerX.data();
+        const float *__restrict cy = centerY.data();
+        const float *__restrict cz = centerZ.data();
+        const float *__restrict ex = extentX.data();
+        const float *__restrict ey = extentY.data();
+        const float *__restrict ez = extentZ.data();
+        const float *__restrict r = radius.data();
+        float *__restrict m = margin.data();
+        for (size_t i = 0; i < count; i++)
+        {
+            float distance = nx * cx[i] + ny * cy[i] + nz * cz[i] + d;
+            // how far the box reaches towards the plane, or the sphere if that reaches less far
+            float reach = std::min(ax * ex[i] + ay * ey[i] + az * ez[i], r[i]);
+            // a min rather than a compare and branch: visibility is close to random per entry
+            m[i] = std::min(m[i], distance + reach);
+        }
+    }
+};
+#endif
@@ -0,0 +1,136 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+
+// where a mesh lives inside a GeometryArena; drawn with
+// glDrawElementsBaseVertex(mode, indexCount, indexType, (void*) indexOffset, baseVertex)
+struct GeometryRange {
+    GLint baseVertex = 0;
+    // in bytes, from the start of the element buffer
+    size_t indexOffset = 0;
+};
+
+// One VAO + vertex buffer + element buffer that many meshes are appended to. All of them share a vertex layout
+// and an index type, so drawing any of them only needs the arena's VAO bound. Indices stay relative to each
+// mesh's first vertex (base vertex), which is what keeps 16-bit indices usable in a large arena.
+// Append-only: meshes are never freed individually. The buffers grow by doubling (copied on the GPU).
+class GeometryArena
+{
+public:
+    // setAttributes: enables and points the vertex attributes at the bound GL_ARRAY_BUFFER (offsets from 0)
+    GeometryArena(GLsizei vertexStride, GLenum indexType, std::function<void()> setAttributes,
+                  size_t initialVertexBytes = 4 << 20, size_t initialIndexBytes = 1 << 20)
+        : vertexStride(vertexStride), indexType(indexType), setAttributes(std::move(setAttributes))
+    {
+        glGenVertexArrays(1, &vao);
+        vertexCapacity = std::max<size_t>(initialVertexBytes, vertexStride);
+        indexCapacity = std::max<size_t>(initialIndexBytes, IndexSize());
+        vertexBuffer = createBuffer(vertexCapacity);
+        indexBuffer = createBuffer(indexCapacity);
+        attachBuffers();
+    }
+
+    ~GeometryArena()
+    {
+        GLState::Instance().DeleteBuffer(vertexBuffer);
+        GLState::Instance().DeleteBuffer(indexBuffer);
+        GLState::Instance().DeleteVertexArray(vao);
+    }
+
+    GeometryArena(const GeometryArena &) = delete;
+    GeometryArena &operator=(const GeometryArena &) = delete;
+
+    // copies a mesh's vertices (vertexCount * stride bytes) and indices (in the arena's index type) to the end of the buffers
+    GeometryRange Allocate(const void *vertexData, size_t vertexCount, const void *indexData, size_t indexCount)
+    {
+        size_t vertexBytes = vertexCount * vertexStride, indexBytes = indexCount * IndexSize();
+        bool grown = grow(vertexBuffer, vertexCapacity, vertexUsed + vertexBytes, vertexUsed);
+        grown |= grow(indexBuffer, indexCapacity, indexUsed + indexBytes, indexUsed);
+        if (grown)
+            attachBuffers();
+
+        GeometryRange range;
+        range.baseVertex = (GLint) (vertexUsed / vertexStride);
+        range.indexOffset = indexUsed;
+        GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, vertexUsed, vertexBytes, vertexData);
+        GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, 0);
+        // the element buffer binding is VAO state; go through the VAO rather than disturbing whatever is bound
+        GLState::Instance().BindVertexArray(vao);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexUsed, indexBytes, indexData);
+        GLState::Instance().BindVertexArray(0);
+
+        vertexUsed += vertexBytes;
+        indexUsed += indexBytes;
+        allocations++;
+        return range;
+    }
+
+    unsigned int VAO() const { return vao; }
+    GLenum IndexType() const { return indexType; }
+    size_t IndexSize() const { return indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint); }
+
+    size_t VertexBytes() const { return vertexUsed; }
+    size_t IndexBytes() const { return indexUsed; }
+    size_t CapacityBytes() const { return vertexCapacity + indexCapacity; }
+    unsigned int Allocations() const { return allocations; }
+
+private:
+    GLsizei vertexStride;
+    GLenum indexType;
+    std::function<void()> setAttributes;
+    unsigned int vao = 0, vertexBuffer = 0, indexBuffer = 0;
+    size_t vertexCapacity = 0, indexCapacity = 0;
+    size_t vertexUsed = 0, indexUsed = 0;
+    unsigned int allocations = 0;
+
+    // allocated through the copy binding point, which no draw state depends on
+    static unsigned int createBuffer(size_t size)
+    {
+        unsigned int buffer;
+        glGenBuffers(1, &buffer);
+        GLState::Instance().BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STATIC_DRAW);
+        GLState::Instance().BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return buffer;
+    }
+
+    // replaces buffer with one of at least `needed` bytes, keeping its first `used` bytes; true if it was replaced
+    static bool grow(unsigned int &buffer, size_t &capacity, size_t needed, size_t used)
+    {
+        if (needed <= capacity)
+            return false;
+        size_t newCapacity = capacity;
+        while (newCapacity < needed)
+            newCapacity *= 2;
+        unsigned int newBuffer = createBuffer(newCapacity);
+        GLState::Instance().BindBuffer(GL_COPY_READ_BUFFER, buffer);
+        GLState::Instance().BindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+        GLState::Instance().BindBuffer(GL_COPY_READ_BUFFER, 0);
+        GLState::Instance().BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        GLState::Instance().DeleteBuffer(buffer);
+        buffer = newBuffer;
+        capacity = newCapacity;
+        return true;
+    }
+
+    // (re)points the VAO at the current buffers
+    void attachBuffers()
+    {
+        GLState::Instance().BindVertexArray(vao);
+        GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        setAttributes();
+        GLState::Instance().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        GLState::Instance().BindVertexArray(0);
+        GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+#endif
@@ -0,0 +1,103 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <unordered_set>
+
+// enums of post-3.3 functionality glad doesn't know about
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// entry points beyond 3.3 core; null when the driver doesn't provide them
+struct GLExtensionFunctions {
+    // GL 4.1 / ARB_get_program_binary
+    void (APIENTRYP GetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary) = nullptr;
+    void (APIENTRYP ProgramBinary)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length) = nullptr;
+    void (APIENTRYP ProgramParameteri)(GLuint program, GLenum pname, GLint value) = nullptr;
+    // KHR_parallel_shader_compile (or the ARB version)
+    void (APIENTRYP MaxShaderCompilerThreads)(GLuint count) = nullptr;
+    // GL 4.3 / ARB_multi_draw_indirect; only loaded together with ARB_base_instance, so the baseInstance of the
+    // commands is honored
+    void (APIENTRYP MultiDrawElementsIndirect)(GLenum mode, GLenum type, const void *indirect, GLsizei drawcount, GLsizei stride) = nullptr;
+};
+
+// glad is generated for plain 3.3 core; this answers which extensions the driver offers on top of it and loads
+// the few newer entry points the renderer can use when they are there.
+class GLExtensions
+{
+public:
+    // needs a current context; the list is read once
+    static bool Has(const std::string &name)
+    {
+        static std::unordered_set<std::string> extensions = readExtensions();
+        return extensions.count(name) != 0;
+    }
+
+    // call once after gladLoadGLLoader, with the same loader
+    static void Load(GLADloadproc load)
+    {
+        GLExtensionFunctions &f = functions();
+        f.GetProgramBinary = reinterpret_cast<decltype(f.GetProgramBinary)>(load("glGetProgramBinary"));
+        f.ProgramBinary = reinterpret_cast<decltype(f.ProgramBinary)>(load("glProgramBinary"));
+        f.ProgramParameteri = reinterpret_cast<decltype(f.ProgramParameteri)>(load("glProgramParameteri"));
+        if (ParallelShaderCompile())
+        {
+            f.MaxShaderCompilerThreads = reinterpret_cast<decltype(f.MaxShaderCompilerThreads)>(load("glMaxShaderCompilerThreadsKHR"));
+            if (!f.MaxShaderCompilerThreads)
+                f.MaxShaderCompilerThreads = reinterpret_cast<decltype(f.MaxShaderCompilerThreads)>(load("glMaxShaderCompilerThreadsARB"));
+            // as many compiler threads as the driver wants to use
+            if (f.MaxShaderCompilerThreads)
+                f.MaxShaderCompilerThreads(0xFFFFFFFFu);
+        }
+        if (Has("GL_ARB_multi_draw_indirect") && Has("GL_ARB_base_instance"))
+            f.MultiDrawElementsIndirect = reinterpret_cast<decltype(f.MultiDrawElementsIndirect)>(load("glMultiDrawElementsIndirect"));
+    }
+
+    // GL_COMPLETION_STATUS_KHR can be queried: whether a compile or link has finished, without waiting for it
+    static bool ParallelShaderCompile()
+    {
+        static bool supported = Has("GL_KHR_parallel_shader_compile") || Has("GL_ARB_parallel_shader_compile");
+        return supported;
+    }
+
+    static const GLExtensionFunctions &Functions()
+    {
+        return functions();
+    }
+
+private:
+    static GLExtensionFunctions &functions()
+    {
+        static GLExtensionFunctions f;
+        return f;
+    }
+
+    static std::unordered_set<std::string> readExtensions()
+    {
+        std::unordered_set<std::string> extensions;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            extensions.insert(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)));
+        return extensions;
+    }
+};
+#endif
@@ -0,0 +1,270 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include <unordered_map>
+
+struct GLStateStats {
+    // state calls asked for, and how many of them were dropped because GL already had that state
+    unsigned long long calls = 0;
+    unsigned long long filtered = 0;
+};
+
+// Shadow copy of the binding and enable state the renderer changes, so setting something GL already has costs no
+// driver call. Only correct if every change of that state goes through here: code that changes it behind the
+// cache's back (ImGui's renderer, other libraries) must be followed by Invalidate(), and deleted objects must be
+// deleted through here, since GL unbinds them and reuses their names.
+// GL_ELEMENT_ARRAY_BUFFER is VAO state and is never cached.
+class GLState
+{
+public:
+    static const int MAX_TEXTURE_UNITS = 32;
+    static const int MAX_UNIFORM_BUFFER_BINDINGS = 16;
+
+    // the cache of the context thread
+    static GLState &Instance()
+    {
+        static GLState state;
+        return state;
+    }
+
+    // forget everything: the next call of each kind reaches GL
+    void Invalidate()
+    {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        activeTexture = UNKNOWN;
+        for (unsigned int &texture : textures2D)
+            texture = UNKNOWN;
+        for (unsigned int &buffer : uniformBindings)
+            buffer = UNKNOWN;
+        buffers.clear();
+        capabilities.clear();
+        depthMask = -1;
+        colorMask = -1;
+        blendSource = blendDestination = UNKNOWN;
+    }
+
+    void UseProgram(GLuint id)
+    {
+        if (filter(program, id))
+            glUseProgram(id);
+    }
+
+    // the current program (asks GL when the cache doesn't know)
+    GLuint CurrentProgram()
+    {
+        if (program == UNKNOWN)
+        {
+            GLint current = 0;
+            glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+            program = (GLuint) current;
+        }
+        return program;
+    }
+
+    void BindVertexArray(GLuint id)
+    {
+        if (filter(vertexArray, id))
+            glBindVertexArray(id);
+    }
+
+    void BindBuffer(GLenum target, GLuint id)
+    {
+        if (target == GL_ELEMENT_ARRAY_BUFFER)
+        {
+            glBindBuffer(target, id);
+            return;
+        }
+        auto found = buffers.emplace(target, UNKNOWN).first;
+        if (filter(found->second, id))
+            glBindBuffer(target, id);
+    }
+
+    // glBindBufferBase; binds the generic GL_UNIFORM_BUFFER target too, like GL does
+    void BindUniformBufferBase(GLuint index, GLuint id)
+    {
+        unsigned int ignored = UNKNOWN;
+        unsigned int &bound = index < MAX_UNIFORM_BUFFER_BINDINGS ? uniformBindings[index] : ignored;
+        if (filter(bound, id))
+        {
+            glBindBufferBase(GL_UNIFORM_BUFFER, index, id);
+            buffers[GL_UNIFORM_BUFFER] = id;
+        }
+    }
+
+    void ActiveTexture(GLuint unit)
+    {
+        if (filter(activeTexture, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    // binds a 2D texture to a unit, switching the active unit only if the binding has to change
+    void BindTexture2D(GLuint unit, GLuint id)
+    {
+        unsigned int ignored = UNKNOWN;
+        unsigned int &bound = unit < MAX_TEXTURE_UNITS ? textures2D[unit] : ignored;
+        if (filter(bound, id))
+        {
+            ActiveTexture(unit);
+            glBindTexture(GL_TEXTURE_2D, id);
+        }
+    }
+
+    // binds a 2D texture to whatever unit is active, e.g. to upload into it
+    void BindTexture2D(GLuint id)
+    {
+        if (activeTexture < (unsigned int) MAX_TEXTURE_UNITS)
+        {
+            if (filter(textures2D[activeTexture], id))
+                glBindTexture(GL_TEXTURE_2D, id);
+            return;
+        }
+        // the active unit isn't known: bind, and stop trusting what the cache thinks any unit has
+        stats.calls++;
+        glBindTexture(GL_TEXTURE_2D, id);
+        for (unsigned int &texture : textures2D)
+            texture = UNKNOWN;
+    }
+
+    void Enable(GLenum capability)
+    {
+        setCapability(capability, true);
+    }
+
+    void Disable(GLenum capability)
+    {
+        setCapability(capability, false);
+    }
+
+    void DepthMask(bool write)
+    {
+        int value = write ? 1 : 0;
+        stats.calls++;
+        if (depthMask == value)
+        {
+            stats.filtered++;
+            return;
+        }
+        depthMask = value;
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    // all four channels at once: the renderer never masks single ones
+    void ColorMask(bool write)
+    {
+        int value = write ? 1 : 0;
+        stats.calls++;
+        if (colorMask == value)
+        {
+            stats.filtered++;
+            return;
+        }
+        colorMask = value;
+        GLboolean mask = write ? GL_TRUE : GL_FALSE;
+        glColorMask(mask, mask, mask, mask);
+    }
+
+    void BlendFunc(GLenum source, GLenum destination)
+    {
+        stats.calls++;
+        if (blendSource == source && blendDestination == destination)
+        {
+            stats.filtered++;
+            return;
+        }
+        blendSource = source;
+        blendDestination = destination;
+        glBlendFunc(source, destination);
+    }
+
+    // deletion drops the names from the cache: GL unbinds deleted objects and hands their names out again
+    void DeleteBuffer(GLuint id)
+    {
+        for (auto &buffer : buffers)
+            if (buffer.second == id)
+                buffer.second = 0;
+        for (unsigned int &buffer : uniformBindings)
+            if (buffer == id)
+                buffer = 0;
+        glDeleteBuffers(1, &id);
+    }
+
+    void DeleteTexture(GLuint id)
+    {
+        for (unsigned int &texture : textures2D)
+            if (texture == id)
+                texture = 0;
+        glDeleteTextures(1, &id);
+    }
+
+    void DeleteVertexArray(GLuint id)
+    {
+        if (vertexArray == id)
+            vertexArray = 0;
+        glDeleteVertexArrays(1, &id);
+    }
+
+    void DeleteProgram(GLuint id)
+    {
+        // a program in use stays current until another one is, so only its name is forgotten
+        if (program == id)
+            program = UNKNOWN;
+        glDeleteProgram(id);
+    }
+
+    GLStateStats Stats() const { return stats; }
+    void ResetStats() { stats = GLStateStats(); }
+
+private:
+    // a value no GL name has: the binding isn't known
+    enum : unsigned int { UNKNOWN = 0xFFFFFFFFu };
+
+    unsigned int program = UNKNOWN;
+    unsigned int vertexArray = UNKNOWN;
+    unsigned int activeTexture = UNKNOWN;
+    unsigned int textures2D[MAX_TEXTURE_UNITS];
+    unsigned int uniformBindings[MAX_UNIFORM_BUFFER_BINDINGS];
+    std::unordered_map<GLenum, unsigned int> buffers;
+    std::unordered_map<GLenum, bool> capabilities;
+    int depthMask = -1;
+    int colorMask = -1;
+    GLenum blendSource = UNKNOWN, blendDestination = UNKNOWN;
+    GLStateStats stats;
+
+    GLState()
+    {
+        Invalidate();
+    }
+
+    // counts the call; true if GL has to be called (and the cache now holds value)
+    bool filter(unsigned int &cached, unsigned int value)
+    {
+        stats.calls++;
+        if (cached == value)
+        {
+            stats.filtered++;
+            return false;
+        }
+        cached = value;
+        return true;
+    }
+
+    void setCapability(GLenum capability, bool enabled)
+    {
+        stats.calls++;
+        auto found = capabilities.find(capability);
+        if (found != capabilities.end() && found->second == enabled)
+        {
+            stats.filtered++;
+            return;
+        }
+        capabilities[capability] = enabled;
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+    }
+};
+#endif
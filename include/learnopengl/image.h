@@ -0,0 +1,114 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// 8-bit image in CPU memory, rows stored in the order they come from the decoder, channels interleaved.
+struct Image {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::vector<unsigned char> pixels;
+
+    const unsigned char *Pixel(int x, int y) const
+    {
+        return &pixels[((size_t) y * width + x) * channels];
+    }
+};
+
+namespace image_detail {
+
+// conversions between 8-bit sRGB and linear light; toSrgb is indexed by linear value * 4095
+struct SrgbTables {
+    float toLinear[256];
+    unsigned char toSrgb[4096];
+
+    SrgbTables()
+    {
+        for (int i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        for (int i = 0; i < 4096; i++)
+        {
+            float c = i / 4095.0f;
+            float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+            toSrgb[i] = (unsigned char) std::lround(std::min(std::max(s, 0.0f), 1.0f) * 255.0f);
+        }
+    }
+};
+
+inline const SrgbTables &srgbTables()
+{
+    static const SrgbTables tables;
+    return tables;
+}
+
+// taps of the 2x downsampling filter: output texel i covers source texels 2i-1 .. 2i+2 with weights 1 3 3 1 (/8),
+// the separable kernel of a bilinear 2x reduction; wider than a box, so it doesn't alias and keeps texel centers in place
+const float DOWNSAMPLE_WEIGHTS[4] = {1.0f / 8.0f, 3.0f / 8.0f, 3.0f / 8.0f, 1.0f / 8.0f};
+
+} // namespace image_detail
+
+// next mip level: half the size (rounded down, at least 1), filtered with a [1 3 3 1] tent kernel in both directions.
+// srgb: the color channels hold sRGB encoded color and are averaged in linear light (alpha is always linear).
+inline Image DownsampleImage(const Image &source, bool srgb = false, ThreadPool &pool = ThreadPool::Shared())
+{
+    using namespace image_detail;
+    const float *toLinear = srgbTables().toLinear;
+    const unsigned char *toSrgb = srgbTables().toSrgb;
+
+    Image result;
+    result.width = std::max(1, source.width / 2);
+    result.height = std::max(1, source.height / 2);
+    result.channels = source.channels;
+    result.pixels.resize((size_t) result.width * result.height * result.channels);
+    int colorChannels = source.channels == 4 || source.channels == 2 ? source.channels - 1 : source.channels;
+
+    // horizontal taps (clamped to the edge) are the same for every row
+    std::vector<int> columns(result.width * 4);
+    for (int x = 0; x < result.width; x++)
+        for (int t = 0; t < 4; t++)
+            columns[x * 4 + t] = std::min(std::max(2 * x - 1 + t, 0), source.width - 1);
+
+    pool.ParallelFor(result.height, [&](size_t y) {
+        std::vector<float> sum(source.channels);
+        for (int x = 0; x < result.width; x++)
+        {
+            std::fill(sum.begin(), sum.end(), 0.0f);
+            for (int ty = 0; ty < 4; ty++)
+            {
+                int sy = std::min(std::max(2 * (int) y - 1 + ty, 0), source.height - 1);
+                for (int tx = 0; tx < 4; tx++)
+                {
+                    float weight = DOWNSAMPLE_WEIGHTS[ty] * DOWNSAMPLE_WEIGHTS[tx];
+                    const unsigned char *texel = source.Pixel(columns[x * 4 + tx], sy);
+                    for (int c = 0; c < source.channels; c++)
+                        sum[c] += weight * (srgb && c < colorChannels ? toLinear[texel[c]] : texel[c] / 255.0f);
+                }
+            }
+            unsigned char *out = &result.pixels[((size_t) y * result.width + x) * result.channels];
+            for (int c = 0; c < source.channels; c++)
+            {
+                float value = std::min(std::max(sum[c], 0.0f), 1.0f);
+                out[c] = srgb && c < colorChannels ? toSrgb[(int) std::lround(value * 4095.0f)] : (unsigned char) std::lround(value * 255.0f);
+            }
+        }
+    });
+    return result;
+}
+
+// full mip chain down to 1x1, base level first
+inline std::vector<Image> BuildMipChain(const Image &base, bool srgb = false)
+{
+    std::vector<Image> levels(1, base);
+    while (levels.back().width > 1 || levels.back().height > 1)
+        levels.push_back(DownsampleImage(levels.back(), srgb));
+    return levels;
+}
+#endif
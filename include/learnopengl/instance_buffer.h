@@ -0,0 +1,88 @@
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+
+#include <vector>
+
+// first of the three vertex attributes holding an instance's transform (5, 6, 7)
+const GLuint INSTANCE_TRANSFORM_ATTRIBUTE = 5;
+
+// The first three rows of an affine model matrix (the last row is always 0 0 0 1): 48 bytes per instance instead
+// of 64. The INSTANCED shader variants rebuild the mat4 from them.
+struct InstanceTransform {
+    glm::vec4 rows[3];
+};
+
+inline InstanceTransform MakeInstanceTransform(const glm::mat4 &model)
+{
+    InstanceTransform transform;
+    for (int row = 0; row < 3; row++)
+        transform.rows[row] = glm::vec4(model[0][row], model[1][row], model[2][row], model[3][row]);
+    return transform;
+}
+
+// The buffer the per-instance transforms of an instanced draw are streamed into. There is one for the process:
+// every VAO points its instance attributes at it when it is set up (SetAttributes), so instanced draws need no
+// extra VAO state. The attributes stay disabled outside instanced draws (EnableAttributes around them): the buffer
+// is empty until the first Upload and afterwards holds whatever the last instanced draw left there, which plain
+// draws have no business fetching from.
+class InstanceBuffer
+{
+public:
+    // needs the GL context; created on first use
+    static InstanceBuffer &Shared()
+    {
+        static InstanceBuffer buffer;
+        return buffer;
+    }
+
+    // replaces the contents; the storage is respecified each time so draws still reading the previous
+    // instances don't stall the upload
+    void Upload(const std::vector<InstanceTransform> &transforms)
+    {
+        GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, transforms.size() * sizeof(InstanceTransform), transforms.data(), GL_STREAM_DRAW);
+        GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // points the instance attributes of the bound VAO at the shared buffer (one element per instance), disabled
+    static void SetAttributes()
+    {
+        GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, Shared().buffer);
+        for (GLuint row = 0; row < 3; row++)
+        {
+            GLuint attribute = INSTANCE_TRANSFORM_ATTRIBUTE + row;
+            glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceTransform),
+                                  (void*)(row * sizeof(glm::vec4)));
+            glVertexAttribDivisor(attribute, 1);
+        }
+    }
+
+    // enables the instance attributes of the bound VAO for an instanced draw, or disables them again after it
+    static void EnableAttributes(bool enabled)
+    {
+        for (GLuint row = 0; row < 3; row++)
+        {
+            if (enabled)
+                glEnableVertexAttribArray(INSTANCE_TRANSFORM_ATTRIBUTE + row);
+            else
+                glDisableVertexAttribArray(INSTANCE_TRANSFORM_ATTRIBUTE + row);
+        }
+    }
+
+    InstanceBuffer(const InstanceBuffer &) = delete;
+    InstanceBuffer &operator=(const InstanceBuffer &) = delete;
+
+private:
+    unsigned int buffer = 0;
+
+    InstanceBuffer()
+    {
+        glGenBuffers(1, &buffer);
+    }
+};
+#endif
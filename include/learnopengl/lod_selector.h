@@ -0,0 +1,106 @@
+#ifndef LOD_SELECTOR_H
+#define LOD_SELECTOR_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// closer than this counts as this close, so a camera inside an object's bounds doesn't divide by zero
+const float LOD_MIN_DISTANCE = 1e-3f;
+
+struct LODStats {
+    size_t objects = 0;
+    // triangles drawn with the selected LODs, and what LOD 0 everywhere would have drawn
+    size_t triangles = 0, fullTriangles = 0;
+    // objects whose LOD changed since the previous frame
+    size_t switches = 0;
+};
+
+// Picks a LOD per object from the screen-space size of its geometric error: an error of e model units seen at
+// distance d covers e * pixelsPerUnit / d pixels, with pixelsPerUnit from the vertical field of view (Camera::Zoom)
+// and the viewport height. The coarsest LOD whose projected error stays under the threshold is drawn.
+// Objects remember their LOD (by a dense id picked by the caller) for hysteresis: a finer LOD is only switched to
+// once the current one's error is `hysteresis` above the threshold, a coarser one only once its error is that far
+// below it, so an object sitting right at a threshold doesn't pop back and forth.
+class LODSelector
+{
+public:
+    // pixels: projected error allowed; hysteresis: relative width of the band around it in which the LOD is kept
+    explicit LODSelector(float pixels = 1.0f, float hysteresis = 0.25f) : threshold(pixels), hysteresis(hysteresis)
+    {
+    }
+
+    void SetThreshold(float pixels) { threshold = pixels; }
+    float Threshold() const { return threshold; }
+
+    // once per frame: the camera's vertical field of view in degrees (Camera::Zoom), the viewport height in pixels
+    // and the camera position
+    void SetView(float fovDegrees, float viewportHeight, const glm::vec3 &position)
+    {
+        pixelsPerUnit = viewportHeight / (2.0f * std::tan(glm::radians(fovDegrees) * 0.5f));
+        viewPosition = position;
+        stats = LODStats();
+    }
+
+    const glm::vec3 &ViewPosition() const { return viewPosition; }
+
+    // pixels an error of `error` world units covers at `distance` from the camera
+    float ProjectedError(float error, float distance) const
+    {
+        return error * pixelsPerUnit / std::max(distance, LOD_MIN_DISTANCE);
+    }
+
+    // the LOD for object out of levelCount, given the world-space error of each level (errorOf(level), not
+    // decreasing, 0 for LOD 0) and the distance from the camera to the nearest point of its bounds
+    template<typename ErrorOf>
+    unsigned int Select(uint32_t object, unsigned int levelCount, float distance, ErrorOf errorOf)
+    {
+        if (object >= levels.size())
+            levels.resize(object + 1, 0);
+        unsigned int current = std::min((unsigned int) levels[object], levelCount - 1);
+        unsigned int selected = current;
+        if (ProjectedError(errorOf(current), distance) > threshold * (1.0f + hysteresis))
+        {
+            // too coarse: the coarsest finer LOD that is good enough
+            while (selected > 0 && ProjectedError(errorOf(selected), distance) > threshold)
+                selected--;
+        }
+        else
+        {
+            // coarser only with a margin
+            while (selected + 1 < levelCount && ProjectedError(errorOf(selected + 1), distance) <= threshold / (1.0f + hysteresis))
+                selected++;
+        }
+        stats.objects++;
+        stats.switches += selected != levels[object];
+        levels[object] = (uint8_t) selected;
+        return selected;
+    }
+
+    // adds one drawn object to the stats
+    void CountTriangles(size_t drawn, size_t full)
+    {
+        stats.triangles += drawn;
+        stats.fullTriangles += full;
+    }
+
+    // forgets the objects' LODs, e.g. when the ids are reused for other objects
+    void Reset()
+    {
+        levels.clear();
+    }
+
+    const LODStats &Stats() const { return stats; }
+
+private:
+    float threshold;
+    float hysteresis;
+    float pixelsPerUnit = 1.0f;
+    glm::vec3 viewPosition = glm::vec3(0.0f);
+    std::vector<uint8_t> levels;
+    LODStats stats;
+};
+#endif
@@ -0,0 +1,147 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/uniform_buffer.h>
+
+#include <cstring>
+#include <string>
+
+// The texture kinds a material can have. Each slot has its own texture unit (its index), fixed for every program:
+// samplers are pointed at their unit once after linking (BindMaterialSamplers), so drawing only binds textures.
+enum class TextureSlot : unsigned int {
+    Diffuse,
+    Specular,
+    Normal,
+    Height,
+    Count
+};
+
+const unsigned int TEXTURE_SLOT_COUNT = (unsigned int) TextureSlot::Count;
+
+// Texture::type names as used by the model importer and the sampler uniforms (texture_diffuse1, ...)
+const char *const TEXTURE_SLOT_TYPES[TEXTURE_SLOT_COUNT] = {"texture_diffuse", "texture_specular", "texture_normal", "texture_height"};
+
+// the slot of a Texture::type, or TextureSlot::Count for a type no slot has
+inline TextureSlot TextureSlotForType(const std::string &type)
+{
+    for (unsigned int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++)
+        if (type == TEXTURE_SLOT_TYPES[slot])
+            return (TextureSlot) slot;
+    return TextureSlot::Count;
+}
+
+inline GLint TextureSlotUnit(TextureSlot slot)
+{
+    return (GLint) slot;
+}
+
+// sets every sampler of the program named after a slot (texture_diffuse1, material.texture_diffuse1, ...) to that
+// slot's unit; called once after linking. Only the first texture of a slot is a material's, so only the samplers
+// numbered 1 are set.
+inline void BindMaterialSamplers(GLuint program)
+{
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    GLuint previous = 0;
+    bool bound = false;
+    std::string name(maxLength > 0 ? maxLength : 1, '\0');
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type;
+        glGetActiveUniform(program, i, (GLsizei) name.size(), &length, &size, &type, &name[0]);
+        if (type != GL_SAMPLER_2D)
+            continue;
+        // the member name of a struct uniform ("material.texture_diffuse1")
+        std::string member(name.data(), length);
+        size_t dot = member.rfind('.');
+        if (dot != std::string::npos)
+            member = member.substr(dot + 1);
+        for (unsigned int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++)
+        {
+            if (member != std::string(TEXTURE_SLOT_TYPES[slot]) + "1")
+                continue;
+            // GL 3.3 has no glProgramUniform: set it through the current program and restore that afterwards
+            if (!bound)
+            {
+                previous = GLState::Instance().CurrentProgram();
+                GLState::Instance().UseProgram(program);
+                bound = true;
+            }
+            glUniform1i(glGetUniformLocation(program, name.c_str()), TextureSlotUnit((TextureSlot) slot));
+        }
+    }
+    if (bound)
+        GLState::Instance().UseProgram(previous);
+}
+
+// What a mesh's surface looks like: one texture per slot and the MaterialData parameters in a uniform buffer of
+// its own. Made once at import; Bind does no lookups, string work or allocation.
+class Material
+{
+public:
+    Material() : parameters(MATERIAL_DATA_BINDING)
+    {
+        std::memset(textures, 0, sizeof(textures));
+        data = MaterialData();
+        data.shininess = 32.0f;
+        parameters.Update(data);
+    }
+
+    Material(const Material &) = delete;
+    Material &operator=(const Material &) = delete;
+
+    // the first texture given for a slot is kept
+    void SetTexture(TextureSlot slot, unsigned int textureID)
+    {
+        if (slot != TextureSlot::Count && textures[(unsigned int) slot] == 0)
+            textures[(unsigned int) slot] = textureID;
+    }
+
+    bool HasTexture(TextureSlot slot) const
+    {
+        return TextureID(slot) != 0;
+    }
+
+    unsigned int TextureID(TextureSlot slot) const
+    {
+        return slot == TextureSlot::Count ? 0 : textures[(unsigned int) slot];
+    }
+
+    const MaterialData &Data() const { return data; }
+
+    // drawn blended, after the opaque draws (see RenderQueue)
+    bool Translucent() const { return translucent; }
+    void SetTranslucent(bool value) { translucent = value; }
+
+    void SetShininess(float shininess)
+    {
+        data.shininess = shininess;
+        parameters.Update(data);
+    }
+
+    // binds the textures to their slots' units and the parameters to MATERIAL_DATA_BINDING; units that already
+    // hold the right texture are left alone
+    void Bind() const
+    {
+        for (unsigned int slot = 0; slot < TEXTURE_SLOT_COUNT; slot++)
+        {
+            if (textures[slot] == 0)
+                continue;
+            GLState::Instance().BindTexture2D(TextureSlotUnit((TextureSlot) slot), textures[slot]);
+        }
+        parameters.Bind();
+    }
+
+private:
+    unsigned int textures[TEXTURE_SLOT_COUNT];
+    MaterialData data;
+    bool translucent = false;
+    UniformBuffer<MaterialData> parameters;
+};
+#endif
@@ -6,8 +6,17 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/bounds.h>
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/instance_buffer.h>
+#include <learnopengl/material.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/vertex_packing.h>
 
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 using namespace std;
@@ -33,6 +42,42 @@ struct Texture {
     string path;
 };
 
+// a texture binding that has not been loaded yet: what a model needs to know to load it
+struct TextureRef {
+    string type;
+    string path;
+};
+
+// one simplified version of a mesh (learnopengl/mesh_simplifier.h); it reuses the mesh's vertices
+struct MeshLOD {
+    // range in MeshLODChain::indices
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+    // how far (in model units) the simplified surface may be from the full one
+    float error = 0.0f;
+};
+
+// the simplified versions of a mesh, coarser and coarser; their indices follow the mesh's own in its element buffer
+struct MeshLODChain {
+    vector<unsigned int> indices;
+    vector<MeshLOD> levels;
+};
+
+// every index of a mesh with at most this many vertices fits GL_UNSIGNED_SHORT
+inline bool CanUseShortIndices(size_t vertexCount)
+{
+    return vertexCount <= 65536;
+}
+
+// how a mesh's data goes into its GL buffers
+struct MeshUploadOptions {
+    // GL_UNSIGNED_SHORT indices when the mesh is small enough
+    bool shortIndices = false;
+    VertexLayout layout = VertexLayout::Standard;
+    // append to the shared GeometryArena of the layout instead of creating buffers for this mesh alone
+    bool shareGeometry = false;
+};
+
 class Mesh {
 public:
     // mesh Data
@@ -41,99 +86,311 @@ public:
     vector<Texture>      textures;
 
     unsigned int VAO;
-    std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // type of the element buffer: GL_UNSIGNED_INT, or GL_UNSIGNED_SHORT when the mesh was created with shortIndices
+    // and is small enough. `indices` always keeps the 32-bit values.
+    GLenum indexType = GL_UNSIGNED_INT;
+    // format of the vertex buffer; for Packed, positions are stored relative to positionQuantization
+    VertexLayout layout = VertexLayout::Standard;
+    PositionQuantization positionQuantization;
+    // what `textures` look like to the shaders; may be shared with other meshes
+    shared_ptr<Material> material;
+    // box and sphere around the vertices, in the mesh's own space; empty (never culled) unless the importer set them
+    MeshBounds bounds;
+    // simplified versions drawn at a distance; LOD 0 is the mesh itself (indices), LOD i is lods.levels[i - 1]
+    MeshLODChain lods;
+    // constructor; without a material one is made from the textures
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, MeshUploadOptions upload = MeshUploadOptions(),
+         shared_ptr<Material> material = nullptr, MeshLODChain lods = MeshLODChain())
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        this->material = material ? material : MakeMaterial(this->textures);
+        this->lods = std::move(lods);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size(), upload);
+    }
+
+    // constructor for data that already lives in memory (e.g. a mapped mesh cache); the buffers are uploaded straight from it
+    Mesh(const Vertex *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount, vector<Texture> textures,
+         MeshUploadOptions upload = MeshUploadOptions(), shared_ptr<Material> material = nullptr, MeshLODChain lods = MeshLODChain())
+    {
+        this->textures = textures;
+        this->material = material ? material : MakeMaterial(this->textures);
+        this->lods = std::move(lods);
+        setupMesh(vertices, vertexCount, indices, indexCount, upload);
+
+        this->vertices.assign(vertices, vertices + vertexCount);
+        this->indices.assign(indices, indices + indexCount);
+    }
+
+    // a material with the first texture of each slot; textures of other types are left out
+    static shared_ptr<Material> MakeMaterial(const vector<Texture> &textures)
+    {
+        shared_ptr<Material> material = make_shared<Material>();
+        for (const Texture &texture : textures)
+            material->SetTexture(TextureSlotForType(texture.type), texture.id);
+        return material;
     }
 
     // render the mesh
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        material->Bind();
+
+        // draw mesh; bindings are left in place (GLState skips them if the next draw needs the same)
+        GLState::Instance().BindVertexArray(VAO);
+        DrawElements(shader);
+    }
+
+    // the ShaderFeature bits of the cheapest shader variant that can draw this mesh
+    uint32_t ShaderFeatures() const
+    {
+        uint32_t features = layout == VertexLayout::Packed ? SHADER_PACKED_VERTICES : 0u;
+        if (material->HasTexture(TextureSlot::Diffuse))
+            features |= SHADER_DIFFUSE_MAP;
+        if (material->HasTexture(TextureSlot::Specular))
+            features |= SHADER_SPECULAR_MAP;
+        if (material->HasTexture(TextureSlot::Normal))
+            features |= SHADER_NORMAL_MAP;
+        return features;
+    }
+
+    // issues the draw call for a LOD; VAO has to be bound already (several meshes in a GeometryArena share it)
+    void DrawElements(Shader &shader, unsigned int lod = 0)
+    {
+        SetPositionDequantization(shader);
+        glDrawElementsBaseVertex(GL_TRIANGLES, IndexCount(lod), indexType, (void*)IndexOffset(lod), baseVertex);
+    }
+
+    // draws instanceCount copies with the transforms in the InstanceBuffer; VAO has to be bound already
+    void DrawElementsInstanced(Shader &shader, GLsizei instanceCount, unsigned int lod = 0)
+    {
+        SetPositionDequantization(shader);
+        InstanceBuffer::EnableAttributes(true);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, IndexCount(lod), indexType, (void*)IndexOffset(lod), instanceCount, baseVertex);
+        InstanceBuffer::EnableAttributes(false);
+    }
+
+    // LOD 0 (the mesh itself) plus the simplified levels
+    unsigned int LODCount() const { return 1 + (unsigned int) lods.levels.size(); }
+
+    // geometric error of a LOD in model units; 0 for LOD 0
+    float LODError(unsigned int lod) const { return lod == 0 ? 0.0f : lods.levels[lod - 1].error; }
+
+    GLsizei IndexCount(unsigned int lod = 0) const
+    {
+        return lod == 0 ? (GLsizei) indices.size() : (GLsizei) lods.levels[lod - 1].indexCount;
+    }
+
+    size_t TriangleCount(unsigned int lod = 0) const { return IndexCount(lod) / 3; }
+
+    // the packed vertex shader dequantizes positions with the mesh's bounds; DrawElements* call this themselves
+    void SetPositionDequantization(Shader &shader)
+    {
+        if (layout != VertexLayout::Packed)
+            return;
+        const ShaderBindings &bound = bindingsFor(shader);
+        shader.setVec3(bound.positionOffset, positionQuantization.offset);
+        shader.setVec3(bound.positionScale, positionQuantization.scale);
+    }
+
+    // the dequantization as a matrix (identity for the Standard layout), for folding it into a model matrix
+    glm::mat4 PositionTransform() const
+    {
+        if (layout != VertexLayout::Packed)
+            return glm::mat4(1.0f);
+        return glm::scale(glm::translate(glm::mat4(1.0f), positionQuantization.offset), positionQuantization.scale);
+    }
+
+    // where the indices of a LOD start in the element buffer (bytes) and the vertex they are relative to
+    size_t IndexOffset(unsigned int lod = 0) const
+    {
+        if (lod == 0)
+            return indexOffset;
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+        return indexOffset + (indices.size() + lods.levels[lod - 1].firstIndex) * indexSize;
+    }
+    GLint BaseVertex() const { return baseVertex; }
+
+    static GLsizei VertexStride(VertexLayout layout)
+    {
+        return layout == VertexLayout::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+    }
+
+    // enables the attributes of a layout and points them at the bound GL_ARRAY_BUFFER, plus the per-instance
+    // transform at the shared InstanceBuffer (left disabled, and the buffer left bound to GL_ARRAY_BUFFER)
+    static void SetVertexAttributes(VertexLayout layout)
+    {
+        if (layout == VertexLayout::Packed)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            // vertex positions (+ bitangent sign in w)
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+            // octahedral normals
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+            // half float texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, texCoords));
+            // octahedral tangent; there is no bitangent attribute
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 2, GL_SHORT, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, tangent));
         }
+        else
+        {
+            // vertex Positions
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+            // vertex normals
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+            // vertex texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+            // vertex tangent
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+            // vertex bitangent
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        }
+        // per-instance transform, read by the INSTANCED shader variants; enabled only around instanced draws
+        InstanceBuffer::SetAttributes();
+    }
+
+    // the process-wide arena for a vertex layout / index type combination; created on first use (needs the GL context)
+    static GeometryArena &SharedArena(VertexLayout layout, GLenum indexType)
+    {
+        unique_ptr<GeometryArena> &arena = sharedArenas()[{layout, indexType}];
+        if (!arena)
+            arena.reset(new GeometryArena(VertexStride(layout), indexType, [layout]() { SetVertexAttributes(layout); }));
+        return *arena;
+    }
 
+    // deletes the shared arenas while the GL context is still current; meshes in them can't be drawn afterwards.
+    // Call before the context is destroyed, static destruction would be too late.
+    static void ReleaseSharedArenas()
+    {
+        sharedArenas().clear();
+    }
 
+private:
+    static map<pair<VertexLayout, GLenum>, unique_ptr<GeometryArena>> &sharedArenas()
+    {
+        static map<pair<VertexLayout, GLenum>, unique_ptr<GeometryArena>> arenas;
+        return arenas;
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // the uniforms Draw sets, resolved for the program they were last used with
+    struct ShaderBindings {
+        unsigned int program = 0;
+        UniformHandle positionOffset, positionScale;
+    };
+    ShaderBindings bindings;
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    const ShaderBindings &bindingsFor(const Shader &shader)
+    {
+        if (bindings.program == shader.ID)
+            return bindings;
+        bindings.program = shader.ID;
+        bindings.positionOffset = shader.uniform("positionOffset");
+        bindings.positionScale = shader.uniform("positionScale");
+        return bindings;
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
+    // render data; VBO and EBO are 0 when the mesh lives in a shared GeometryArena
+    unsigned int VBO = 0, EBO = 0;
+    // where the mesh starts in its buffers (non-zero only in an arena)
+    GLint baseVertex = 0;
+    size_t indexOffset = 0;
 
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const Vertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount, const MeshUploadOptions &upload)
     {
+        // bring the data into the upload format first
+        layout = upload.layout;
+        const void *vertexBytes = vertexData;
+        vector<PackedVertex> packedVertices;
+        if (layout == VertexLayout::Packed)
+        {
+            packedVertices = packVertices(vertexData, vertexCount);
+            vertexBytes = packedVertices.data();
+        }
+        // the LODs' indices go right after the mesh's own
+        vector<unsigned int> allIndices;
+        if (!lods.indices.empty())
+        {
+            allIndices.reserve(indexCount + lods.indices.size());
+            allIndices.assign(indexData, indexData + indexCount);
+            allIndices.insert(allIndices.end(), lods.indices.begin(), lods.indices.end());
+            indexData = allIndices.data();
+            indexCount = allIndices.size();
+        }
+        const void *indexBytes = indexData;
+        vector<unsigned short> shortIndexData;
+        if (upload.shortIndices && CanUseShortIndices(vertexCount))
+        {
+            // half the index bandwidth and memory
+            shortIndexData.assign(indexData, indexData + indexCount);
+            indexBytes = shortIndexData.data();
+            indexType = GL_UNSIGNED_SHORT;
+        }
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+
+        if (upload.shareGeometry)
+        {
+            GeometryArena &arena = SharedArena(layout, indexType);
+            GeometryRange range = arena.Allocate(vertexBytes, vertexCount, indexBytes, indexCount);
+            VAO = arena.VAO();
+            baseVertex = range.baseVertex;
+            indexOffset = range.indexOffset;
+            return;
+        }
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        GLState::Instance().BindVertexArray(VAO);
         // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * VertexStride(layout), vertexBytes, GL_STATIC_DRAW);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        GLState::Instance().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize, indexBytes, GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        SetVertexAttributes(layout);
+
+        GLState::Instance().BindVertexArray(0);
+    }
+
+    // quantized to PackedVertex, relative to the mesh's bounds
+    vector<PackedVertex> packVertices(const Vertex *vertexData, size_t vertexCount)
+    {
+        glm::vec3 boundsMin(0.0f), boundsMax(0.0f);
+        if (vertexCount > 0)
+            boundsMin = boundsMax = vertexData[0].Position;
+        for (size_t i = 1; i < vertexCount; i++)
+        {
+            boundsMin = glm::min(boundsMin, vertexData[i].Position);
+            boundsMax = glm::max(boundsMax, vertexData[i].Position);
+        }
+        positionQuantization = PositionQuantization(boundsMin, boundsMax);
+
+        vector<PackedVertex> packed(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            const Vertex &v = vertexData[i];
+            packed[i] = PackVertex(v.Position, v.Normal, v.TexCoords, v.Tangent, v.Bitangent, positionQuantization);
+        }
+        return packed;
     }
 };
-#endif
\ No newline at end of file
+#endif
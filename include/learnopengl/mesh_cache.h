@@ -0,0 +1,368 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+#include <common.h>
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <type_traits>
+
+// On-disk cache of the final (post-import) mesh data of a model.
+//
+// File layout (all offsets are from the start of the file, blobs are 16-byte aligned):
+//   MeshCacheHeader
+//   MeshCacheEntry[meshCount]
+//   MeshCacheTexture[textureCount]
+//   string table (texture types and paths, not null terminated)
+//   per mesh: Vertex[vertexCount], unsigned int[indexCount], then for its LODs unsigned int[lodIndexCount], MeshLOD[lodCount]
+// The vertex and index blobs are stored exactly as they are uploaded, so a mapped file can be handed to glBufferData as-is.
+
+static_assert(std::is_trivially_copyable<Vertex>::value, "Vertex must be trivially copyable to be cached");
+static_assert(std::is_trivially_copyable<MeshLOD>::value, "MeshLOD must be trivially copyable to be cached");
+
+const char MESH_CACHE_MAGIC[8] = {'R', 'G', 'M', 'E', 'S', 'H', '\0', '\0'};
+// bump whenever Vertex, the file layout or the import pipeline changes
+const uint32_t MESH_CACHE_VERSION = 3;
+
+struct MeshCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t vertexSize;
+    uint32_t importFlags;   // aiPostProcessSteps the data was imported with
+    uint32_t pipelineFlags; // our own post-import stages that ran on the data
+    int64_t sourceMtime;
+    int64_t sourceMtimeNsec;
+    uint64_t sourceSize;
+    uint64_t sourcePathHash;
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint64_t meshTableOffset;
+    uint64_t textureTableOffset;
+    uint64_t stringTableOffset;
+    uint64_t stringTableSize;
+    uint64_t fileSize;
+};
+
+struct MeshCacheEntry {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    // Mesh::bounds; the sphere is centered on the box
+    float boundsMin[3];
+    float boundsMax[3];
+    float sphereRadius;
+    uint32_t padding;
+    // Mesh::lods
+    uint64_t lodIndexOffset;
+    uint64_t lodTableOffset;
+    uint32_t lodIndexCount;
+    uint32_t lodCount;
+};
+
+struct MeshCacheTexture {
+    uint32_t typeOffset;
+    uint32_t typeLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+class MeshCache
+{
+public:
+    // cache file for a source model; one file per source path
+    static string CachePathFor(const string &sourcePath)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.mesh", (unsigned long long) hashString(sourcePath));
+        return cacheDirectory() + "/meshes/" + name;
+    }
+
+    MeshCache() = default;
+    MeshCache(const MeshCache&) = delete;
+    MeshCache& operator=(const MeshCache&) = delete;
+    ~MeshCache()
+    {
+        Close();
+    }
+
+    // maps the cache for sourcePath; fails if it is missing, corrupted or stale with respect to the key
+    bool Open(const string &sourcePath, uint32_t importFlags, uint32_t pipelineFlags)
+    {
+        Close();
+        FileStamp stamp;
+        if (!getFileStamp(sourcePath, stamp))
+            return false;
+
+        int fd = open(CachePathFor(sourcePath).c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(MeshCacheHeader))
+        {
+            close(fd);
+            return false;
+        }
+        void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED)
+            return false;
+        data = static_cast<const unsigned char*>(mapping);
+        size = st.st_size;
+
+        const MeshCacheHeader &h = Header();
+        bool valid = memcmp(h.magic, MESH_CACHE_MAGIC, sizeof(h.magic)) == 0
+                && h.version == MESH_CACHE_VERSION
+                && h.vertexSize == sizeof(Vertex)
+                && h.importFlags == importFlags
+                && h.pipelineFlags == pipelineFlags
+                && h.sourceMtime == stamp.mtime
+                && h.sourceMtimeNsec == stamp.mtimeNsec
+                && h.sourceSize == stamp.size
+                && h.sourcePathHash == hashString(sourcePath)
+                && h.fileSize == size
+                && inBounds(h.meshTableOffset, (uint64_t) h.meshCount * sizeof(MeshCacheEntry))
+                && inBounds(h.textureTableOffset, (uint64_t) h.textureCount * sizeof(MeshCacheTexture))
+                && inBounds(h.stringTableOffset, h.stringTableSize);
+        for (uint32_t i = 0; valid && i < h.meshCount; i++)
+        {
+            const MeshCacheEntry &e = Entry(i);
+            valid = inBounds(e.vertexOffset, (uint64_t) e.vertexCount * sizeof(Vertex))
+                    && inBounds(e.indexOffset, (uint64_t) e.indexCount * sizeof(unsigned int))
+                    && inBounds(e.lodIndexOffset, (uint64_t) e.lodIndexCount * sizeof(unsigned int))
+                    && inBounds(e.lodTableOffset, (uint64_t) e.lodCount * sizeof(MeshLOD))
+                    && (uint64_t) e.firstTexture + e.textureCount <= h.textureCount;
+            for (uint32_t level = 0; valid && level < e.lodCount; level++)
+            {
+                const MeshLOD &lod = lodTable(i)[level];
+                valid = (uint64_t) lod.firstIndex + lod.indexCount <= e.lodIndexCount;
+            }
+        }
+        for (uint32_t i = 0; valid && i < h.textureCount; i++)
+        {
+            const MeshCacheTexture &t = textureTable()[i];
+            valid = (uint64_t) t.typeOffset + t.typeLength <= h.stringTableSize
+                    && (uint64_t) t.pathOffset + t.pathLength <= h.stringTableSize;
+        }
+        if (!valid)
+            Close();
+        return valid;
+    }
+
+    void Close()
+    {
+        if (data)
+            munmap(const_cast<unsigned char*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+
+    const MeshCacheHeader &Header() const
+    {
+        return *reinterpret_cast<const MeshCacheHeader*>(data);
+    }
+
+    unsigned int MeshCount() const
+    {
+        return Header().meshCount;
+    }
+
+    const MeshCacheEntry &Entry(unsigned int mesh) const
+    {
+        return reinterpret_cast<const MeshCacheEntry*>(data + Header().meshTableOffset)[mesh];
+    }
+
+    const Vertex *Vertices(unsigned int mesh) const
+    {
+        return reinterpret_cast<const Vertex*>(data + Entry(mesh).vertexOffset);
+    }
+
+    const unsigned int *Indices(unsigned int mesh) const
+    {
+        return reinterpret_cast<const unsigned int*>(data + Entry(mesh).indexOffset);
+    }
+
+    MeshBounds Bounds(unsigned int mesh) const
+    {
+        const MeshCacheEntry &e = Entry(mesh);
+        MeshBounds bounds;
+        bounds.box.min = glm::vec3(e.boundsMin[0], e.boundsMin[1], e.boundsMin[2]);
+        bounds.box.max = glm::vec3(e.boundsMax[0], e.boundsMax[1], e.boundsMax[2]);
+        bounds.sphere.center = bounds.box.Center();
+        bounds.sphere.radius = e.sphereRadius;
+        return bounds;
+    }
+
+    MeshLODChain LODs(unsigned int mesh) const
+    {
+        const MeshCacheEntry &e = Entry(mesh);
+        MeshLODChain lods;
+        const unsigned int *indices = reinterpret_cast<const unsigned int*>(data + e.lodIndexOffset);
+        lods.indices.assign(indices, indices + e.lodIndexCount);
+        lods.levels.assign(lodTable(mesh), lodTable(mesh) + e.lodCount);
+        return lods;
+    }
+
+    vector<TextureRef> Textures(unsigned int mesh) const
+    {
+        vector<TextureRef> refs;
+        const MeshCacheEntry &e = Entry(mesh);
+        const char *strings = reinterpret_cast<const char*>(data + Header().stringTableOffset);
+        for (uint32_t i = e.firstTexture; i < e.firstTexture + e.textureCount; i++)
+        {
+            const MeshCacheTexture &t = textureTable()[i];
+            refs.push_back({string(strings + t.typeOffset, t.typeLength), string(strings + t.pathOffset, t.pathLength)});
+        }
+        return refs;
+    }
+
+    // writes the meshes of sourcePath to its cache file; the file is replaced atomically so readers never see a partial cache
+    static bool Store(const string &sourcePath, uint32_t importFlags, uint32_t pipelineFlags, const vector<Mesh> &meshes)
+    {
+        FileStamp stamp;
+        if (!getFileStamp(sourcePath, stamp))
+            return false;
+
+        MeshCacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+        header.version = MESH_CACHE_VERSION;
+        header.vertexSize = sizeof(Vertex);
+        header.importFlags = importFlags;
+        header.pipelineFlags = pipelineFlags;
+        header.sourceMtime = stamp.mtime;
+        header.sourceMtimeNsec = stamp.mtimeNsec;
+        header.sourceSize = stamp.size;
+        header.sourcePathHash = hashString(sourcePath);
+        header.meshCount = meshes.size();
+
+        vector<MeshCacheEntry> entries(meshes.size());
+        vector<MeshCacheTexture> textures;
+        string strings;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            entries[i].vertexCount = meshes[i].vertices.size();
+            entries[i].indexCount = meshes[i].indices.size();
+            entries[i].firstTexture = textures.size();
+            entries[i].textureCount = meshes[i].textures.size();
+            const MeshBounds &bounds = meshes[i].bounds;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                entries[i].boundsMin[axis] = bounds.box.min[axis];
+                entries[i].boundsMax[axis] = bounds.box.max[axis];
+            }
+            entries[i].sphereRadius = bounds.sphere.radius;
+            entries[i].lodIndexCount = meshes[i].lods.indices.size();
+            entries[i].lodCount = meshes[i].lods.levels.size();
+            for (const Texture &texture : meshes[i].textures)
+            {
+                MeshCacheTexture t;
+                t.typeOffset = strings.size();
+                t.typeLength = texture.type.size();
+                strings += texture.type;
+                t.pathOffset = strings.size();
+                t.pathLength = texture.path.size();
+                strings += texture.path;
+                textures.push_back(t);
+            }
+        }
+        header.textureCount = textures.size();
+
+        uint64_t offset = sizeof(MeshCacheHeader);
+        header.meshTableOffset = offset = align(offset);
+        offset += entries.size() * sizeof(MeshCacheEntry);
+        header.textureTableOffset = offset = align(offset);
+        offset += textures.size() * sizeof(MeshCacheTexture);
+        header.stringTableOffset = offset;
+        header.stringTableSize = strings.size();
+        offset += strings.size();
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            entries[i].vertexOffset = offset = align(offset);
+            offset += meshes[i].vertices.size() * sizeof(Vertex);
+            entries[i].indexOffset = offset = align(offset);
+            offset += meshes[i].indices.size() * sizeof(unsigned int);
+            entries[i].lodIndexOffset = offset = align(offset);
+            offset += meshes[i].lods.indices.size() * sizeof(unsigned int);
+            entries[i].lodTableOffset = offset = align(offset);
+            offset += meshes[i].lods.levels.size() * sizeof(MeshLOD);
+        }
+        header.fileSize = offset;
+
+        string cachePath = CachePathFor(sourcePath);
+        if (!createDirectories(cachePath.substr(0, cachePath.find_last_of('/'))))
+            return false;
+        string tmpPath = cachePath + ".tmp";
+        FILE *out = fopen(tmpPath.c_str(), "wb");
+        if (!out)
+            return false;
+        uint64_t written = 0;
+        bool ok = writeAt(out, written, 0, &header, sizeof(header))
+                && writeAt(out, written, header.meshTableOffset, entries.data(), entries.size() * sizeof(MeshCacheEntry))
+                && writeAt(out, written, header.textureTableOffset, textures.data(), textures.size() * sizeof(MeshCacheTexture))
+                && writeAt(out, written, header.stringTableOffset, strings.data(), strings.size());
+        for (unsigned int i = 0; ok && i < meshes.size(); i++)
+        {
+            ok = writeAt(out, written, entries[i].vertexOffset, meshes[i].vertices.data(), meshes[i].vertices.size() * sizeof(Vertex))
+                 && writeAt(out, written, entries[i].indexOffset, meshes[i].indices.data(), meshes[i].indices.size() * sizeof(unsigned int))
+                 && writeAt(out, written, entries[i].lodIndexOffset, meshes[i].lods.indices.data(), meshes[i].lods.indices.size() * sizeof(unsigned int))
+                 && writeAt(out, written, entries[i].lodTableOffset, meshes[i].lods.levels.data(), meshes[i].lods.levels.size() * sizeof(MeshLOD));
+        }
+        ok = fclose(out) == 0 && ok;
+        if (!ok || rename(tmpPath.c_str(), cachePath.c_str()) != 0)
+        {
+            cout << "ERROR::MESH_CACHE:: failed to write " << cachePath << endl;
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+
+    const MeshCacheTexture *textureTable() const
+    {
+        return reinterpret_cast<const MeshCacheTexture*>(data + Header().textureTableOffset);
+    }
+
+    const MeshLOD *lodTable(unsigned int mesh) const
+    {
+        return reinterpret_cast<const MeshLOD*>(data + Entry(mesh).lodTableOffset);
+    }
+
+    bool inBounds(uint64_t offset, uint64_t length) const
+    {
+        return offset <= size && length <= size - offset;
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 15) & ~uint64_t(15);
+    }
+
+    // writes bytes so that they end up at `offset`, zero padding the (alignment) gap after what was written before
+    static bool writeAt(FILE *out, uint64_t &written, uint64_t offset, const void *bytes, size_t count)
+    {
+        static const char zeros[16] = {};
+        if (written > offset || offset - written > sizeof(zeros))
+            return false;
+        if (fwrite(zeros, 1, offset - written, out) != offset - written)
+            return false;
+        written = offset + count;
+        return count == 0 || fwrite(bytes, 1, count, out) == count;
+    }
+};
+#endif
@@ -0,0 +1,515 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <common.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Import-time LOD generation: edge collapses ordered by quadric error (Garland & Heckbert, "Surface Simplification
+// Using Quadric Error Metrics"). Every collapse moves a vertex onto a neighbour (half-edge collapse), so a LOD is only
+// a new index list over the mesh's own vertices and the vertex buffer is shared by the whole chain.
+//
+// Vertices that share a position but differ in any attribute (UV or normal seams, the "wedges" of that position) are
+// handled as one position, and a collapse is only made when every wedge of the vertex that goes away has a matching
+// wedge to go to along the collapsed edge: seam vertices can slide along the seam, but a seam is never torn open or
+// smeared across. Seam and open border edges additionally get constraint planes in the quadrics, so they keep their
+// shape, and a vertex on an open border only collapses along it.
+
+// a collapse is rejected when it turns a neighbouring triangle by more than this (cosine of about 75 degrees)
+const float SIMPLIFY_MAX_NORMAL_CHANGE_COS = 0.25f;
+
+// symmetric 4x4 matrix of a sum of squared plane distances, weighted by area (the upper triangle, in doubles)
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0, a11 = 0, a12 = 0, a13 = 0, a22 = 0, a23 = 0, a33 = 0;
+    // summed weight, to turn an evaluated sum back into an average squared distance
+    double weight = 0;
+
+    // weight * (dot(normal, p) + distance)^2; normal has to be unit length
+    static Quadric FromPlane(const glm::vec3 &normal, float distance, double weight)
+    {
+        Quadric q;
+        double a = normal.x, b = normal.y, c = normal.z, d = distance;
+        q.a00 = weight * a * a; q.a01 = weight * a * b; q.a02 = weight * a * c; q.a03 = weight * a * d;
+        q.a11 = weight * b * b; q.a12 = weight * b * c; q.a13 = weight * b * d;
+        q.a22 = weight * c * c; q.a23 = weight * c * d;
+        q.a33 = weight * d * d;
+        q.weight = weight;
+        return q;
+    }
+
+    void Add(const Quadric &q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23;
+        a33 += q.a33;
+        weight += q.weight;
+    }
+
+    // the weighted sum of squared distances from p to the planes
+    double Evaluate(const glm::vec3 &p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double result = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x +
+                        a11 * y * y + 2 * a12 * y * z + 2 * a13 * y +
+                        a22 * z * z + 2 * a23 * z +
+                        a33;
+        return result > 0 ? result : 0;
+    }
+};
+
+// simplifies one indexed triangle list in steps; each Simplify call continues from where the last one stopped, so a
+// chain of LODs is built coarser and coarser from the same quadrics
+class MeshSimplifier
+{
+public:
+    // a seam or border edge weighs this many times more than a face of the same extent
+    enum { BOUNDARY_WEIGHT = 10 };
+
+    MeshSimplifier(const vector<Vertex> &vertices, const vector<unsigned int> &meshIndices)
+    {
+        // vertices identical in every attribute are one wedge, vertices at the same position are one position
+        struct VertexHash {
+            size_t operator()(const Vertex &v) const { return hashBytes(&v, sizeof(Vertex)); }
+        };
+        struct VertexEqual {
+            bool operator()(const Vertex &a, const Vertex &b) const { return memcmp(&a, &b, sizeof(Vertex)) == 0; }
+        };
+        struct PositionHash {
+            size_t operator()(const glm::vec3 &p) const { return hashBytes(&p, sizeof(glm::vec3)); }
+        };
+        struct PositionEqual {
+            bool operator()(const glm::vec3 &a, const glm::vec3 &b) const { return memcmp(&a, &b, sizeof(glm::vec3)) == 0; }
+        };
+        unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> wedges;
+        unordered_map<glm::vec3, unsigned int, PositionHash, PositionEqual> positionIds;
+        vector<unsigned int> wedgeOf(vertices.size());
+        positionOf.resize(vertices.size());
+        for (unsigned int i = 0; i < vertices.size(); i++)
+        {
+            wedgeOf[i] = wedges.insert({vertices[i], i}).first->second;
+            auto inserted = positionIds.insert({vertices[i].Position, (unsigned int) positions.size()});
+            if (inserted.second)
+                positions.push_back(vertices[i].Position);
+            positionOf[i] = inserted.first->second;
+        }
+
+        // the triangles over wedges, without the ones that are degenerate already
+        indices.reserve(meshIndices.size());
+        for (size_t t = 0; t + 2 < meshIndices.size(); t += 3)
+        {
+            unsigned int a = wedgeOf[meshIndices[t]], b = wedgeOf[meshIndices[t + 1]], c = wedgeOf[meshIndices[t + 2]];
+            if (positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[a] == positionOf[c])
+                continue;
+            indices.push_back(a);
+            indices.push_back(b);
+            indices.push_back(c);
+        }
+        computeQuadrics();
+    }
+
+    const vector<unsigned int> &Indices() const { return indices; }
+    size_t TriangleCount() const { return indices.size() / 3; }
+    // the largest error of the collapses made so far, as a distance in model units
+    float Error() const { return error; }
+
+    // collapses edges, cheapest first, until at most targetTriangles are left, no collapse stays under maxError or
+    // none is possible without breaking the mesh
+    void Simplify(size_t targetTriangles, float maxError)
+    {
+        const int MAX_PASSES = 100;
+        for (int pass = 0; pass < MAX_PASSES && TriangleCount() > targetTriangles; pass++)
+            if (!collapsePass(targetTriangles, maxError))
+                break;
+    }
+
+private:
+    // per vertex index of the mesh: its position id
+    vector<unsigned int> positionOf;
+    vector<glm::vec3> positions;
+    vector<Quadric> quadrics;
+    // current triangles; every index is the first vertex of its wedge
+    vector<unsigned int> indices;
+    float error = 0.0f;
+
+    // per pass: the triangles around each position (CSR) and the position-space edges
+    vector<unsigned int> firstTriangle, triangles;
+    struct Edge {
+        unsigned int a, b; // positions, a < b
+        unsigned int triangleCount;
+    };
+    vector<Edge> edges;
+    vector<char> border, locked, touched;
+    vector<unsigned int> remap;
+
+    struct Collapse {
+        unsigned int from, to;
+        double cost;
+    };
+
+    unsigned int positionAt(size_t corner) const
+    {
+        return positionOf[indices[corner]];
+    }
+
+    glm::vec3 faceNormal(size_t t) const
+    {
+        const glm::vec3 &p0 = positions[positionAt(t * 3)];
+        return glm::cross(positions[positionAt(t * 3 + 1)] - p0, positions[positionAt(t * 3 + 2)] - p0);
+    }
+
+    // position-space edges of the current triangles, sorted; with per triangle side the wedges at both ends
+    struct EdgeSide {
+        unsigned int a, b;
+        unsigned int wedgeA, wedgeB;
+        unsigned int triangle;
+        bool operator<(const EdgeSide &other) const
+        {
+            return a != other.a ? a < other.a : b < other.b;
+        }
+    };
+
+    void collectEdgeSides(vector<EdgeSide> &sides) const
+    {
+        sides.clear();
+        sides.reserve(indices.size());
+        for (size_t t = 0; t < indices.size() / 3; t++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int wa = indices[t * 3 + k], wb = indices[t * 3 + (k + 1) % 3];
+                unsigned int a = positionOf[wa], b = positionOf[wb];
+                if (a > b)
+                {
+                    std::swap(a, b);
+                    std::swap(wa, wb);
+                }
+                sides.push_back({a, b, wa, wb, (unsigned int) t});
+            }
+        }
+        std::sort(sides.begin(), sides.end());
+    }
+
+    // face planes weighted by area, plus perpendicular planes along seams and open borders
+    void computeQuadrics()
+    {
+        quadrics.assign(positions.size(), Quadric());
+        for (size_t t = 0; t < indices.size() / 3; t++)
+        {
+            glm::vec3 normal = faceNormal(t);
+            float length = glm::length(normal);
+            if (length == 0.0f)
+                continue;
+            normal /= length;
+            const glm::vec3 &p0 = positions[positionAt(t * 3)];
+            Quadric face = Quadric::FromPlane(normal, -glm::dot(normal, p0), 0.5 * length);
+            for (int k = 0; k < 3; k++)
+                quadrics[positionAt(t * 3 + k)].Add(face);
+        }
+
+        vector<EdgeSide> sides;
+        collectEdgeSides(sides);
+        for (size_t begin = 0; begin < sides.size();)
+        {
+            size_t end = begin + 1;
+            while (end < sides.size() && sides[end].a == sides[begin].a && sides[end].b == sides[begin].b)
+                end++;
+            bool boundary = end - begin == 1;
+            for (size_t i = begin + 1; i < end && !boundary; i++)
+                boundary = sides[i].wedgeA != sides[begin].wedgeA || sides[i].wedgeB != sides[begin].wedgeB;
+            if (boundary)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    const glm::vec3 &pa = positions[sides[i].a], &pb = positions[sides[i].b];
+                    glm::vec3 perpendicular = glm::cross(pb - pa, faceNormal(sides[i].triangle));
+                    float length = glm::length(perpendicular);
+                    if (length == 0.0f)
+                        continue;
+                    perpendicular /= length;
+                    double weight = BOUNDARY_WEIGHT * glm::dot(pb - pa, pb - pa);
+                    Quadric plane = Quadric::FromPlane(perpendicular, -glm::dot(perpendicular, pa), weight);
+                    quadrics[sides[i].a].Add(plane);
+                    quadrics[sides[i].b].Add(plane);
+                }
+            }
+            begin = end;
+        }
+    }
+
+    // adjacency, edges and vertex classes of the current triangles
+    void buildTopology()
+    {
+        size_t triangleCount = indices.size() / 3;
+        firstTriangle.assign(positions.size() + 1, 0);
+        for (size_t corner = 0; corner < indices.size(); corner++)
+            firstTriangle[positionAt(corner) + 1]++;
+        for (size_t p = 0; p < positions.size(); p++)
+            firstTriangle[p + 1] += firstTriangle[p];
+        triangles.resize(indices.size());
+        vector<unsigned int> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                triangles[filled[positionAt(t * 3 + k)]++] = (unsigned int) t;
+
+        vector<EdgeSide> sides;
+        collectEdgeSides(sides);
+        edges.clear();
+        border.assign(positions.size(), 0);
+        locked.assign(positions.size(), 0);
+        for (size_t begin = 0; begin < sides.size();)
+        {
+            size_t end = begin + 1;
+            while (end < sides.size() && sides[end].a == sides[begin].a && sides[end].b == sides[begin].b)
+                end++;
+            Edge edge = {sides[begin].a, sides[begin].b, (unsigned int) (end - begin)};
+            if (edge.triangleCount == 1)
+                border[edge.a] = border[edge.b] = 1;
+            // non-manifold edges stay as they are
+            if (edge.triangleCount > 2)
+                locked[edge.a] = locked[edge.b] = 1;
+            edges.push_back(edge);
+            begin = end;
+        }
+    }
+
+    bool triangleHas(unsigned int t, unsigned int position) const
+    {
+        return positionAt(t * 3) == position || positionAt(t * 3 + 1) == position || positionAt(t * 3 + 2) == position;
+    }
+
+    // the other two positions of the triangles around p
+    void neighbours(unsigned int p, vector<unsigned int> &result) const
+    {
+        result.clear();
+        for (unsigned int i = firstTriangle[p]; i < firstTriangle[p + 1]; i++)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int q = positionAt(triangles[i] * 3 + k);
+                if (q != p)
+                    result.push_back(q);
+            }
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+    }
+
+    // checks the collapse of position `from` onto `to` and fills remap for the wedges of `from`
+    bool tryCollapse(unsigned int from, unsigned int to, unsigned int edgeTriangles, vector<unsigned int> &ringFrom,
+                     vector<unsigned int> &ringTo)
+    {
+        // the mesh stays manifold: the two rings only meet at the vertices opposite the edge
+        neighbours(from, ringFrom);
+        neighbours(to, ringTo);
+        size_t common = 0;
+        for (size_t i = 0, j = 0; i < ringFrom.size() && j < ringTo.size();)
+        {
+            if (ringFrom[i] < ringTo[j])
+                i++;
+            else if (ringFrom[i] > ringTo[j])
+                j++;
+            else
+            {
+                common++;
+                i++;
+                j++;
+            }
+        }
+        if (common != edgeTriangles)
+            return false;
+
+        // every wedge of `from` needs the wedge of `to` it sits next to across the edge, the same one everywhere
+        vector<std::pair<unsigned int, unsigned int>> wedgeMap;
+        for (unsigned int i = firstTriangle[from]; i < firstTriangle[from + 1]; i++)
+        {
+            unsigned int t = triangles[i];
+            unsigned int fromWedge = 0, toWedge = ~0u;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int wedge = indices[t * 3 + k];
+                if (positionOf[wedge] == from)
+                    fromWedge = wedge;
+                else if (positionOf[wedge] == to)
+                    toWedge = wedge;
+            }
+            bool found = false;
+            for (std::pair<unsigned int, unsigned int> &entry : wedgeMap)
+            {
+                if (entry.first != fromWedge)
+                    continue;
+                found = true;
+                if (toWedge != ~0u)
+                {
+                    if (entry.second != ~0u && entry.second != toWedge)
+                        return false;
+                    entry.second = toWedge;
+                }
+            }
+            if (!found)
+                wedgeMap.push_back({fromWedge, toWedge});
+        }
+        for (const std::pair<unsigned int, unsigned int> &entry : wedgeMap)
+            if (entry.second == ~0u)
+                return false;
+
+        // no remaining triangle around `from` may flip or fold over
+        const glm::vec3 &target = positions[to];
+        for (unsigned int i = firstTriangle[from]; i < firstTriangle[from + 1]; i++)
+        {
+            unsigned int t = triangles[i];
+            if (triangleHas(t, to))
+                continue;
+            glm::vec3 corners[3];
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int p = positionAt(t * 3 + k);
+                corners[k] = p == from ? target : positions[p];
+            }
+            glm::vec3 before = faceNormal(t);
+            glm::vec3 after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+            // (triangles that are degenerate already can't get worse; none may become degenerate)
+            float beforeLength = glm::length(before);
+            if (beforeLength > 0.0f && glm::dot(before, after) <= SIMPLIFY_MAX_NORMAL_CHANGE_COS * beforeLength * glm::length(after))
+                return false;
+        }
+
+        for (const std::pair<unsigned int, unsigned int> &entry : wedgeMap)
+            remap[entry.first] = entry.second;
+        return true;
+    }
+
+    // one round of independent collapses; false when none was made
+    bool collapsePass(size_t targetTriangles, float maxError)
+    {
+        buildTopology();
+
+        // the cheaper direction of every edge that may collapse at all
+        vector<Collapse> collapses;
+        collapses.reserve(edges.size());
+        for (const Edge &edge : edges)
+        {
+            Quadric merged = quadrics[edge.a];
+            merged.Add(quadrics[edge.b]);
+            Collapse best = {0, 0, -1.0};
+            unsigned int ends[2] = {edge.a, edge.b};
+            for (int direction = 0; direction < 2; direction++)
+            {
+                unsigned int from = ends[direction], to = ends[1 - direction];
+                // a vertex on an open border only moves along it
+                if (locked[from] || locked[to] || (border[from] && edge.triangleCount != 1))
+                    continue;
+                double cost = merged.Evaluate(positions[to]) / std::max(merged.weight, 1e-30);
+                if (best.cost < 0.0 || cost < best.cost)
+                    best = {from, to, cost};
+            }
+            if (best.cost >= 0.0 && std::sqrt(best.cost) <= maxError)
+                collapses.push_back(best);
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.cost < b.cost; });
+
+        // collapses whose neighbourhoods don't overlap, so the topology built above stays valid for each of them
+        size_t triangleCount = TriangleCount();
+        touched.assign(positions.size(), 0);
+        remap.resize(positionOf.size());
+        for (unsigned int i = 0; i < remap.size(); i++)
+            remap[i] = i;
+        vector<unsigned int> ringFrom, ringTo;
+        bool collapsed = false;
+        for (const Collapse &collapse : collapses)
+        {
+            if (triangleCount <= targetTriangles)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+            unsigned int edgeTriangles = 0;
+            for (unsigned int i = firstTriangle[collapse.from]; i < firstTriangle[collapse.from + 1]; i++)
+                edgeTriangles += triangleHas(triangles[i], collapse.to);
+            if (!tryCollapse(collapse.from, collapse.to, edgeTriangles, ringFrom, ringTo))
+                continue;
+
+            quadrics[collapse.to].Add(quadrics[collapse.from]);
+            error = std::max(error, (float) std::sqrt(collapse.cost));
+            triangleCount -= edgeTriangles;
+            collapsed = true;
+            touched[collapse.from] = touched[collapse.to] = 1;
+            for (unsigned int p : ringFrom)
+                touched[p] = 1;
+            for (unsigned int p : ringTo)
+                touched[p] = 1;
+        }
+        if (!collapsed)
+            return false;
+
+        // move the collapsed wedges and drop the triangles that became degenerate
+        size_t kept = 0;
+        for (size_t t = 0; t < indices.size() / 3; t++)
+        {
+            unsigned int a = remap[indices[t * 3]], b = remap[indices[t * 3 + 1]], c = remap[indices[t * 3 + 2]];
+            if (positionOf[a] == positionOf[b] || positionOf[b] == positionOf[c] || positionOf[a] == positionOf[c])
+                continue;
+            indices[kept++] = a;
+            indices[kept++] = b;
+            indices[kept++] = c;
+        }
+        indices.resize(kept);
+        return true;
+    }
+};
+
+struct LODGenerationOptions {
+    // each level aims for this fraction of the previous level's triangles
+    float reduction = 0.5f;
+    unsigned int maxLevels = 4;
+    // no level is made with fewer triangles than this
+    size_t minTriangles = 64;
+    // largest error a level may have, relative to the diagonal of the mesh's bounds
+    float maxRelativeError = 0.05f;
+    // reorder each level's triangles for the vertex cache, like the optimization stage does for the mesh itself
+    bool optimizeVertexCache = true;
+};
+
+// the LOD chain of a mesh over its own vertices. The chain ends early when a level would not remove at least a tenth
+// of the previous level's triangles (everything left is pinned by seams, borders or the error limit).
+inline MeshLODChain GenerateLODs(const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+                                 const LODGenerationOptions &options = LODGenerationOptions())
+{
+    MeshLODChain chain;
+    if (indices.size() / 3 <= options.minTriangles)
+        return chain;
+    BoundingBox box;
+    for (const Vertex &vertex : vertices)
+        box.Expand(vertex.Position);
+    float maxError = options.maxRelativeError * glm::length(box.max - box.min);
+
+    MeshSimplifier simplifier(vertices, indices);
+    size_t previous = indices.size() / 3;
+    for (unsigned int level = 0; level < options.maxLevels; level++)
+    {
+        size_t target = std::max(options.minTriangles, (size_t) (previous * options.reduction));
+        simplifier.Simplify(target, maxError);
+        size_t triangles = simplifier.TriangleCount();
+        if (triangles == 0 || triangles > previous - previous / 10)
+            break;
+
+        vector<unsigned int> levelIndices = simplifier.Indices();
+        if (options.optimizeVertexCache)
+            OptimizeVertexCache(levelIndices, vertices.size());
+        MeshLOD lod;
+        lod.firstIndex = (unsigned int) chain.indices.size();
+        lod.indexCount = (unsigned int) levelIndices.size();
+        lod.error = simplifier.Error();
+        chain.indices.insert(chain.indices.end(), levelIndices.begin(), levelIndices.end());
+        chain.levels.push_back(lod);
+        previous = triangles;
+        if (triangles <= options.minTriangles)
+            break;
+    }
+    return chain;
+}
+#endif
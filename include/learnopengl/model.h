@@ -10,8 +10,18 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <learnopengl/frustum.h>
+#include <learnopengl/lod_selector.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/occlusion.h>
+#include <learnopengl/occlusion_queries.h>
+#include <learnopengl/render_queue.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/thread_pool.h>
 
 #include <string>
 #include <fstream>
@@ -21,239 +31,613 @@
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+// post-processing steps every model is imported with; part of the mesh cache key
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
+struct ModelImportOptions {
+    // load the final meshes from (and store them to) the binary mesh cache instead of running Assimp on every start
+    bool useMeshCache = true;
+    // convert the imported meshes on the shared worker pool instead of only on the calling thread
+    bool parallelImport = true;
+    // return textures with a placeholder right away and stream them in through AsyncTextureLoader
+    // (which then has to be updated every frame)
+    bool asyncTextures = false;
+    // run textures through the texture import stage: mip chains built on first load, read from the texture cache after
+    bool bakeTextures = false;
+    // additionally BCn compress baked textures (implies bakeTextures)
+    bool compressTextures = false;
+    // weld identical vertices, reorder triangles and vertices for the GPU caches and use 16-bit indices where they fit
+    bool optimizeMeshes = false;
+    // vertex buffer format; Packed needs a vertex shader that decodes PackedVertex (the PACKED_VERTICES variant of 2.model_lighting.vs)
+    VertexLayout vertexLayout = VertexLayout::Standard;
+    // suballocate the meshes from the scene-wide GeometryArena of their layout instead of a VAO/VBO/EBO each
+    bool shareGeometry = false;
+    // build a chain of simplified LODs per mesh (learnopengl/mesh_simplifier.h), for a LODSelector to pick from
+    bool generateLODs = false;
+    LODGenerationOptions lodOptions;
+};
 
+// bits of Model::pipelineFlags(), stored in the mesh cache
+const uint32_t MESH_PIPELINE_OPTIMIZED = 1u << 0;
+const uint32_t MESH_PIPELINE_LODS = 1u << 1;
+
+// CPU-side result of converting one aiMesh; it becomes a Mesh (GL buffers, loaded textures) on the context thread
+struct MeshData {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    vector<TextureRef> textures;
+    MeshBounds bounds;
+    MeshLODChain lods;
+};
 
 
 class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    ModelImportOptions importOptions;
+    // what the optimization stage did, summed over all meshes; only filled when the model was imported (not cached)
+    MeshOptimizationStats optimizationStats;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    Model(string const &path, bool gamma = false, ModelImportOptions options = ModelImportOptions()) : gammaCorrection(gamma), importOptions(options)
     {
         loadModel(path);
+        computeBounds();
+        computeLODs();
     }
 
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
+        // meshes with the same textures share a material: only rebind it when it changes (VAOs of meshes in a
+        // shared arena are the same, which GLState filters)
+        const Material *boundMaterial = nullptr;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Mesh &mesh = meshes[i];
+            if (mesh.material.get() != boundMaterial)
+            {
+                mesh.material->Bind();
+                boundMaterial = mesh.material.get();
+            }
+            GLState::Instance().BindVertexArray(mesh.VAO);
+            mesh.DrawElements(shader);
+        }
+    }
+
+    // draws every mesh with the variant matching its vertex layout and textures; programs are only switched
+    // when consecutive meshes need different variants. While a variant is still compiling the mesh is drawn with a
+    // simpler one that is ready (ShaderVariants::Find), or skipped if there is none yet.
+    void Draw(ShaderVariants &variants)
+    {
+        const Material *boundMaterial = nullptr;
+        Shader *current = nullptr;
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        {
+            Mesh &mesh = meshes[i];
+            Shader *shader = variants.Find(mesh.ShaderFeatures());
+            if (!shader)
+                continue;
+            if (shader != current)
+            {
+                variants.Use(*shader);
+                current = shader;
+            }
+            if (mesh.material.get() != boundMaterial)
+            {
+                mesh.material->Bind();
+                boundMaterial = mesh.material.get();
+            }
+            GLState::Instance().BindVertexArray(mesh.VAO);
+            mesh.DrawElements(*shader);
+        }
+    }
+
+    // draws the model once per transform with one instanced draw per mesh, using the INSTANCED variants. With a
+    // culler, instances whose model bounds are outside its frustum are left out of the draws. With levels (one per
+    // transform, e.g. from SelectLOD), every mesh is drawn once per LOD in use, each instance with its own LOD.
+    void DrawInstanced(ShaderVariants &variants, const vector<glm::mat4> &transforms, FrustumCuller *culler = nullptr,
+                       const vector<unsigned int> *levels = nullptr)
+    {
+        visibleInstances.clear();
+        if (culler)
+        {
+            culler->Clear();
+            for (const glm::mat4 &transform : transforms)
+                culler->Add(bounds.Transformed(transform));
+            visibleInstances = culler->Cull();
+        }
+        else
+        {
+            for (uint32_t i = 0; i < transforms.size(); i++)
+                visibleInstances.push_back(i);
+        }
+
+        unsigned int levelCount = levels ? LODCount() : 1;
+        for (unsigned int level = 0; level < levelCount; level++)
+        {
+            instanceTransforms.clear();
+            for (uint32_t i : visibleInstances)
+                if (!levels || std::min((*levels)[i], levelCount - 1) == level)
+                    instanceTransforms.push_back(MakeInstanceTransform(transforms[i]));
+            if (instanceTransforms.empty())
+                continue;
+            InstanceBuffer::Shared().Upload(instanceTransforms);
+            drawInstances(variants, (GLsizei) instanceTransforms.size(), level);
+        }
+    }
+
+    // adds a packet per mesh, drawn with the variant Draw(ShaderVariants&) would pick; depth is measured from
+    // viewPosition to the model's origin. With a culler, meshes whose bounds are outside its frustum are left out;
+    // nothing is added at all when the whole model is. With queries, meshes TestOcclusion tests are drawn conditionally
+    // on their last test. With lods, each mesh is drawn with the LOD the selector picks for it (ids are mesh indices).
+    void Enqueue(RenderQueue &queue, ShaderVariants &variants, const glm::mat4 &model, const glm::vec3 &viewPosition,
+                 FrustumCuller *culler = nullptr, OcclusionQueries *queries = nullptr, LODSelector *lods = nullptr)
+    {
+        visibleMeshes.clear();
+        if (culler)
+        {
+            culler->Clear();
+            for (const Mesh &mesh : meshes)
+                culler->Add(mesh.bounds.Transformed(model));
+            visibleMeshes = culler->Cull();
+            if (visibleMeshes.empty())
+                return;
+        }
+        else
+        {
+            for (uint32_t i = 0; i < meshes.size(); i++)
+                visibleMeshes.push_back(i);
+        }
+
+        DrawPacket packet;
+        packet.variants = &variants;
+        packet.object = queue.AddObject(model);
+        packet.depth = glm::length(glm::vec3(model[3]) - viewPosition);
+        float scale = lods ? maxScale(model) : 1.0f;
+        for (uint32_t i : visibleMeshes)
+        {
+            Mesh &mesh = meshes[i];
+            packet.shader = variants.Find(mesh.ShaderFeatures());
+            if (!packet.shader)
+                continue;
+            packet.mesh = &mesh;
+            packet.conditionQuery = queries ? queries->ConditionQuery(i) : 0;
+            packet.lod = 0;
+            if (lods)
+            {
+                float distance = distanceTo(mesh.bounds, model, scale, lods->ViewPosition());
+                packet.lod = lods->Select(i, mesh.LODCount(), distance, [&](unsigned int level) { return mesh.LODError(level) * scale; });
+                lods->CountTriangles(mesh.TriangleCount(packet.lod), mesh.TriangleCount());
+            }
+            queue.Add(packet);
+        }
     }
 
-    void SetShaderTextureNamePrefix(std::string prefix) {
-        for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+    // the LOD of the whole model for one of its instances (object: a dense id for the selector's hysteresis)
+    unsigned int SelectLOD(LODSelector &selector, uint32_t object, const glm::mat4 &model) const
+    {
+        float scale = maxScale(model);
+        float distance = distanceTo(bounds, model, scale, selector.ViewPosition());
+        unsigned int level = selector.Select(object, LODCount(), distance, [&](unsigned int lod) { return lodErrors[lod] * scale; });
+        selector.CountTriangles(lodTriangles[level], lodTriangles[0]);
+        return level;
+    }
+
+    // LODs of the whole model: LOD i draws every mesh with its LOD i, or its coarsest if it has fewer
+    unsigned int LODCount() const { return (unsigned int) lodErrors.size(); }
+    // the largest error of the meshes at a model LOD, in model units
+    float LODError(unsigned int level) const { return lodErrors[level]; }
+    size_t TriangleCount(unsigned int level = 0) const { return lodTriangles[level]; }
+
+    // tests the proxy boxes of the meshes with at least queries.MinTriangles() triangles, query ids being mesh indices;
+    // call between queries.BeginProxies and EndProxies, after the frame is drawn
+    void TestOcclusion(OcclusionQueries &queries, const glm::mat4 &model) const
+    {
+        for (uint32_t i = 0; i < meshes.size(); i++)
+        {
+            const Mesh &mesh = meshes[i];
+            if (mesh.indices.size() / 3 >= queries.MinTriangles() && !mesh.bounds.Empty())
+                queries.Test(i, mesh.bounds.box.Transformed(model));
         }
     }
+
+    // box and sphere around all meshes, in model space
+    const MeshBounds &Bounds() const { return bounds; }
+
+    // the maxTriangles largest triangles of all meshes, for the model to hide others in an OcclusionCuller
+    OccluderMesh MakeOccluder(size_t maxTriangles) const
+    {
+        vector<glm::vec3> positions;
+        vector<uint32_t> indices;
+        for (const Mesh &mesh : meshes)
+        {
+            uint32_t first = (uint32_t) positions.size();
+            for (const Vertex &vertex : mesh.vertices)
+                positions.push_back(vertex.Position);
+            for (unsigned int index : mesh.indices)
+                indices.push_back(first + index);
+        }
+        if (positions.empty())
+            return OccluderMesh();
+        return OccluderMesh::FromTriangles(positions.data(), sizeof(glm::vec3), indices.data(), indices.size(), maxTriangles);
+    }
+
+    // gives the model's textures back to the TextureCache; textures no other model uses are deleted
+    void ReleaseTextures()
+    {
+        for (unsigned int textureID : acquiredTextures)
+            TextureCache::Instance().Release(textureID);
+        acquiredTextures.clear();
+    }
+
 private:
+    // one entry per TextureCache::Acquire made for this model's material slots
+    vector<unsigned int> acquiredTextures;
+    // staging for DrawInstanced and Enqueue, kept to avoid an allocation per call
+    vector<InstanceTransform> instanceTransforms;
+    vector<uint32_t> visibleMeshes, visibleInstances;
+    MeshBounds bounds;
+    // per model LOD: the largest mesh error and the triangles drawn
+    vector<float> lodErrors;
+    vector<size_t> lodTriangles;
+    // one Material per distinct texture list, shared by the meshes that use it
+    map<vector<unsigned int>, shared_ptr<Material>> materials;
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        // warm start: the cache holds the meshes exactly as the import below would produce them
+        if (importOptions.useMeshCache && loadFromCache(path))
+            return;
+
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+
+        if (importOptions.useMeshCache)
+            MeshCache::Store(path, MODEL_IMPORT_FLAGS, pipelineFlags(), meshes);
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // the union of the meshes' bounds; left empty (never culled) if any mesh has none
+    void computeBounds()
+    {
+        bounds = MeshBounds();
+        for (const Mesh &mesh : meshes)
+        {
+            if (mesh.bounds.Empty())
+            {
+                bounds = MeshBounds();
+                return;
+            }
+            bounds.box.Expand(mesh.bounds.box);
+        }
+        if (bounds.Empty())
+            return;
+        bounds.sphere.center = bounds.box.Center();
+        float radius = 0.0f;
+        for (const Mesh &mesh : meshes)
+            radius = std::max(radius, glm::distance(bounds.sphere.center, mesh.bounds.sphere.center) + mesh.bounds.sphere.radius);
+        bounds.sphere.radius = std::min(radius, glm::length(bounds.box.Extents()));
+    }
+
+    // the model LODs from the meshes' chains
+    void computeLODs()
     {
-        // process each mesh located at the current node
+        unsigned int levelCount = 1;
+        for (const Mesh &mesh : meshes)
+            levelCount = std::max(levelCount, mesh.LODCount());
+        lodErrors.assign(levelCount, 0.0f);
+        lodTriangles.assign(levelCount, 0);
+        for (unsigned int level = 0; level < levelCount; level++)
+        {
+            for (const Mesh &mesh : meshes)
+            {
+                unsigned int meshLevel = std::min(level, mesh.LODCount() - 1);
+                lodErrors[level] = std::max(lodErrors[level], mesh.LODError(meshLevel));
+                lodTriangles[level] += mesh.TriangleCount(meshLevel);
+            }
+        }
+    }
+
+    // how much a transform scales distances at most
+    static float maxScale(const glm::mat4 &model)
+    {
+        return std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    }
+
+    // from position to the nearest point of the transformed bounding sphere (0 inside it, or without bounds)
+    static float distanceTo(const MeshBounds &meshBounds, const glm::mat4 &model, float scale, const glm::vec3 &position)
+    {
+        if (meshBounds.Empty())
+            return 0.0f;
+        glm::vec3 center = glm::vec3(model * glm::vec4(meshBounds.sphere.center, 1.0f));
+        return std::max(glm::length(center - position) - meshBounds.sphere.radius * scale, 0.0f);
+    }
+
+    // one instanced draw per mesh, with the transforms in the InstanceBuffer
+    void drawInstances(ShaderVariants &variants, GLsizei instanceCount, unsigned int level)
+    {
+        const Material *boundMaterial = nullptr;
+        Shader *current = nullptr;
+        for (Mesh &mesh : meshes)
+        {
+            Shader *shader = variants.Find(mesh.ShaderFeatures() | SHADER_INSTANCED);
+            if (!shader)
+                continue;
+            if (shader != current)
+            {
+                variants.Use(*shader);
+                current = shader;
+            }
+            if (mesh.material.get() != boundMaterial)
+            {
+                mesh.material->Bind();
+                boundMaterial = mesh.material.get();
+            }
+            GLState::Instance().BindVertexArray(mesh.VAO);
+            mesh.DrawElementsInstanced(*shader, instanceCount, std::min(level, mesh.LODCount() - 1));
+        }
+    }
+
+    // post-import stages that change the mesh data; a cache written with different stages is stale
+    uint32_t pipelineFlags() const
+    {
+        uint32_t flags = 0;
+        if (importOptions.optimizeMeshes)
+            flags |= MESH_PIPELINE_OPTIMIZED;
+        if (importOptions.generateLODs)
+            flags |= MESH_PIPELINE_LODS;
+        return flags;
+    }
+
+    // how the meshes go into GL buffers; not part of the cache key, the cache always holds float vertices
+    MeshUploadOptions uploadOptions() const
+    {
+        MeshUploadOptions upload;
+        upload.shortIndices = importOptions.optimizeMeshes;
+        upload.layout = importOptions.vertexLayout;
+        upload.shareGeometry = importOptions.shareGeometry;
+        return upload;
+    }
+
+    bool loadFromCache(string const &path)
+    {
+        MeshCache cache;
+        if (!cache.Open(path, MODEL_IMPORT_FLAGS, pipelineFlags()))
+            return false;
+
+        meshes.reserve(cache.MeshCount());
+        for (unsigned int i = 0; i < cache.MeshCount(); i++)
+        {
+            vector<Texture> textures;
+            for (const TextureRef &ref : cache.Textures(i))
+                textures.push_back(loadTexture(ref.path, ref.type));
+
+            const MeshCacheEntry &entry = cache.Entry(i);
+            meshes.push_back(Mesh(cache.Vertices(i), entry.vertexCount, cache.Indices(i), entry.indexCount, textures,
+                                  uploadOptions(), materialFor(textures), cache.LODs(i)));
+            meshes.back().bounds = cache.Bounds(i);
+        }
+        return true;
+    }
+
+    // walks the node hierarchy in a recursive fashion and collects the meshes of each node, then those of its children.
+    // The order of the collected meshes is the order of Model::meshes, no matter how they are converted afterwards.
+    void collectMeshes(aiNode *node, const aiScene *scene, vector<aiMesh*> &sceneMeshes)
+    {
+        // collect each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
         }
-        // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
+        // after we've collected all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            collectMeshes(node->mChildren[i], scene, sceneMeshes);
         }
+    }
 
+    void processNode(aiNode *node, const aiScene *scene)
+    {
+        vector<aiMesh*> sceneMeshes;
+        collectMeshes(node, scene, sceneMeshes);
+
+        // CPU conversion doesn't touch OpenGL, so every mesh can be converted on its own thread into its own slot
+        vector<MeshData> converted(sceneMeshes.size());
+        vector<MeshOptimizationStats> stats(sceneMeshes.size());
+        auto convert = [&](size_t i) {
+            converted[i] = processMesh(sceneMeshes[i], scene);
+            if (importOptions.optimizeMeshes)
+                stats[i] = OptimizeMesh(converted[i].vertices, converted[i].indices);
+            if (importOptions.generateLODs)
+            {
+                LODGenerationOptions lodOptions = importOptions.lodOptions;
+                lodOptions.optimizeVertexCache = importOptions.optimizeMeshes;
+                converted[i].lods = GenerateLODs(converted[i].vertices, converted[i].indices, lodOptions);
+            }
+        };
+        if (importOptions.parallelImport)
+            ThreadPool::Shared().ParallelFor(sceneMeshes.size(), convert);
+        else
+            for (size_t i = 0; i < sceneMeshes.size(); i++)
+                convert(i);
+
+        if (importOptions.optimizeMeshes)
+        {
+            for (const MeshOptimizationStats &meshStats : stats)
+                optimizationStats.Add(meshStats);
+            const MeshOptimizationStats &total = optimizationStats;
+            cout << "Mesh optimization: " << total.meshes << " meshes, " << total.triangles << " triangles" << endl
+                 << "  ACMR:     " << total.AcmrBefore() << " -> " << total.AcmrAfter() << endl
+                 << "  vertices: " << total.verticesBefore << " -> " << total.verticesAfter
+                 << " (" << total.vertexBytesBefore << " -> " << total.vertexBytesAfter << " bytes)" << endl
+                 << "  indices:  " << total.indexBytesBefore << " -> " << total.indexBytesAfter << " bytes" << endl;
+        }
+
+        if (importOptions.generateLODs)
+        {
+            // triangles of all meshes per level; meshes with shorter chains count with their coarsest
+            size_t levelCount = 0;
+            for (const MeshData &data : converted)
+                levelCount = std::max(levelCount, data.lods.levels.size());
+            cout << "LODs: " << levelCount << " levels, triangles";
+            for (size_t level = 0; level <= levelCount; level++)
+            {
+                size_t triangles = 0;
+                for (const MeshData &data : converted)
+                {
+                    size_t meshLevel = std::min(level, data.lods.levels.size());
+                    triangles += meshLevel == 0 ? data.indices.size() / 3 : data.lods.levels[meshLevel - 1].indexCount / 3;
+                }
+                cout << (level == 0 ? " " : " -> ") << triangles;
+            }
+            cout << endl;
+        }
+
+        // buffer creation and texture loading need the GL context, which is only current on this thread
+        meshes.reserve(meshes.size() + converted.size());
+        for (MeshData &data : converted)
+        {
+            vector<Texture> textures;
+            for (const TextureRef &ref : data.textures)
+                textures.push_back(loadTexture(ref.path, ref.type));
+            shared_ptr<Material> material = materialFor(textures);
+            meshes.push_back(Mesh(std::move(data.vertices), std::move(data.indices), std::move(textures), uploadOptions(), material,
+                                  std::move(data.lods)));
+            meshes.back().bounds = data.bounds;
+        }
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // converts one aiMesh into our vertex/index layout. Runs on worker threads: must not call OpenGL or modify the model.
+    static MeshData processMesh(const aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vertices.resize(mesh->mNumVertices);
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
+            Vertex &vertex = vertices[i];
             // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
+            vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
             // normals
             if (mesh->HasNormals())
-            {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
-            }
+                vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+            else
+                vertex.Normal = glm::vec3(0.0f);
             // texture coordinates
             if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
             {
-                glm::vec2 vec;
                 // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't
                 // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x;
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
+                vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
                 // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
+                vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
                 // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
+                vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
             }
             else
+            {
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
-
-
+                vertex.Tangent = glm::vec3(0.0f);
+                vertex.Bitangent = glm::vec3(0.0f);
+            }
         }
-        // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        // now walk through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        indices.reserve(mesh->mNumFaces * 3); // triangulated
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
+            const aiFace &face = mesh->mFaces[i];
             // retrieve all indices of the face and store them in the indices vector
-            for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+            indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
         }
+        // bounds for culling; the optimizer only reorders and merges vertices, so they stay valid after it
+        if (!vertices.empty())
+            data.bounds = ComputeBounds(&vertices[0].Position, vertices.size(), sizeof(Vertex));
         // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
         // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER.
         // Same applies to other texture as the following list summarizes:
         // diffuse: texture_diffuseN
         // specular: texture_specularN
         // normal: texture_normalN
-        aiColor3D color(0.0f, 0.0f, 0.0f);
-        material->Get(AI_MATKEY_COLOR_AMBIENT, color);
-
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        collectMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data.textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        collectMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data.textures);
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-        textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+        collectMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", data.textures);
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-        textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-
+        collectMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", data.textures);
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // lists all material textures of a given type; they are loaded later, on the context thread.
+    static void collectMaterialTextures(const aiMaterial *mat, aiTextureType type, const string &typeName, vector<TextureRef> &textures)
     {
-        vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back({typeName, str.C_Str()});
         }
-        return textures;
     }
-};
-
-
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
+    shared_ptr<Material> materialFor(const vector<Texture> &textures)
     {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+        vector<unsigned int> key;
+        for (const Texture &texture : textures)
+            key.push_back(texture.id);
+        shared_ptr<Material> &material = materials[key];
+        if (!material)
+            material = Mesh::MakeMaterial(textures);
+        return material;
     }
-    else
+
+    // gets the texture at path (relative to the model's directory) from the process-wide cache, loading it only if
+    // no other model or material slot uses it yet
+    Texture loadTexture(const string &path, const string &typeName)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        Texture texture;
+        TextureLoadOptions options;
+        options.async = importOptions.asyncTextures;
+        options.gamma = gammaCorrection;
+        options.baked = importOptions.bakeTextures;
+        options.compress = importOptions.compressTextures;
+        options.normalMap = typeName == "texture_normal";
+        options.srgb = typeName == "texture_diffuse";
+        texture.id = TextureCache::Instance().Acquire(this->directory + '/' + path, options);
+        texture.type = typeName;
+        texture.path = path;
+        acquiredTextures.push_back(texture.id);
+        return texture;
     }
+};
+
 
-    return textureID;
-}
 #endif
@@ -0,0 +1,612 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bounds.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Triangles that hide what is behind them, in model space. Any subset of a mesh's real triangles is a conservative
+// occluder (it never hides something the full mesh wouldn't), so a few hundred of the largest ones stand in for it.
+struct OccluderMesh {
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    // per triangle edge (corner k to corner k + 1 of triangle t, at 3 * t + k): the triangle on the other side, -1
+    // where the surface is open there. Empty until FindNeighbours, which counts as every edge open.
+    std::vector<int32_t> neighbours;
+
+    size_t TriangleCount() const { return indices.size() / 3; }
+
+    // links the triangles that share an edge (the same two positions, in opposite directions), so the culler can
+    // tell the outline of a surface from the seams between its own triangles. Edges of more than two triangles stay open.
+    void FindNeighbours()
+    {
+        // vertices at the same position are one vertex
+        auto less = [&](uint32_t a, uint32_t b) {
+            const glm::vec3 &p = positions[a], &q = positions[b];
+            return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+        };
+        std::vector<uint32_t> order(positions.size()), welded(positions.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), less);
+        for (size_t i = 0; i < order.size(); i++)
+            welded[order[i]] = i > 0 && !less(order[i - 1], order[i]) ? welded[order[i - 1]] : order[i];
+
+        // directed edges by (from, to)
+        std::vector<std::pair<uint64_t, uint32_t>> edges(indices.size());
+        for (size_t corner = 0; corner < indices.size(); corner++)
+        {
+            size_t next = corner - corner % 3 + (corner + 1) % 3;
+            edges[corner] = {(uint64_t) welded[indices[corner]] << 32 | welded[indices[next]], (uint32_t) corner};
+        }
+        std::sort(edges.begin(), edges.end());
+        auto withKey = [&](uint64_t key) {
+            return std::equal_range(edges.begin(), edges.end(), std::make_pair(key, 0u),
+                                    [](const std::pair<uint64_t, uint32_t> &x, const std::pair<uint64_t, uint32_t> &y) {
+                                        return x.first < y.first;
+                                    });
+        };
+
+        neighbours.assign(indices.size(), -1);
+        for (const std::pair<uint64_t, uint32_t> &edge : edges)
+        {
+            uint64_t from = edge.first >> 32, to = edge.first & 0xffffffffu;
+            if (from == to)
+                continue;
+            auto same = withKey(edge.first), opposite = withKey(to << 32 | from);
+            if (same.second - same.first == 1 && opposite.second - opposite.first == 1)
+                neighbours[edge.second] = (int32_t) (opposite.first->second / 3);
+        }
+    }
+
+    // the maxTriangles triangles of largest area; positions are taken `stride` bytes apart
+    static OccluderMesh FromTriangles(const glm::vec3 *positions, size_t stride, const uint32_t *indices, size_t indexCount,
+                                      size_t maxTriangles)
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char*>(positions);
+        auto position = [&](uint32_t i) { return *reinterpret_cast<const glm::vec3*>(bytes + i * stride); };
+        size_t triangleCount = indexCount / 3;
+        std::vector<std::pair<float, uint32_t>> byArea(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            glm::vec3 a = position(indices[3 * t]), b = position(indices[3 * t + 1]), c = position(indices[3 * t + 2]);
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            byArea[t] = {glm::dot(normal, normal), (uint32_t) t};
+        }
+        size_t kept = std::min(maxTriangles, triangleCount);
+        std::partial_sort(byArea.begin(), byArea.begin() + kept, byArea.end(),
+                          [](const std::pair<float, uint32_t> &x, const std::pair<float, uint32_t> &y) { return x.first > y.first; });
+
+        OccluderMesh occluder;
+        occluder.positions.reserve(3 * kept);
+        occluder.indices.reserve(3 * kept);
+        for (size_t k = 0; k < kept; k++)
+        {
+            uint32_t t = byArea[k].second;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                occluder.indices.push_back((uint32_t) occluder.positions.size());
+                occluder.positions.push_back(position(indices[3 * t + corner]));
+            }
+        }
+        occluder.FindNeighbours();
+        return occluder;
+    }
+};
+
+// clip-space w below which a point counts as at or behind the camera
+const float OCCLUSION_NEAR_W = 1e-5f;
+
+struct OcclusionStats {
+    // occluder triangles submitted, and how many of them reached the depth buffer (not clipped or off screen)
+    size_t occluderTriangles = 0;
+    size_t rasterizedTriangles = 0;
+    // boxes tested, and how many of them were hidden
+    size_t tested = 0;
+    size_t occluded = 0;
+};
+
+// CPU occlusion culling. Occluders are rasterized into a small depth buffer (nearest NDC depth per pixel, 1 where
+// nothing was drawn), from which a hierarchy of min and max depths per 2x2, 4x4, ... block is built. A box is hidden
+// if, wherever its screen rectangle goes, the pixels are all nearer than the nearest point of the box; the hierarchy
+// answers that for most boxes from a few coarse texels.
+//
+//     occlusion.Begin(projection * view);
+//     occlusion.AddOccluder(occluder, model);   // a few large, near objects
+//     occlusion.Rasterize();
+//     if (occlusion.IsVisible(worldBox)) draw();
+//
+// Rasterization splits the screen into bands of rows that the ThreadPool fills in parallel; each band sees every
+// triangle, spans are shaded 4 pixels at a time with SSE2 where available.
+//
+// The depth buffer is much coarser than the screen (at 256x128 one of its pixels covers about 5x5 screen pixels), so
+// it has to stay conservative where an occluder covers a pixel only in part. Triangles are drawn where they cover a
+// pixel's center, with the farthest depth they have inside the pixel; then every pixel the outline of an occluder
+// passes through is opened again (depth 1). The outline is the open edges of the OccluderMesh (see FindNeighbours),
+// the edges where it folds from facing the camera to facing away, and where the near plane cuts it. A pixel no
+// outline passes through is covered entirely or not at all, so nothing seen past an occluder's edge is culled.
+class OcclusionCuller
+{
+public:
+    // the width is rounded up to a multiple of 4, the SIMD span width
+    explicit OcclusionCuller(int width = 256, int height = 128) : width((width + 3) & ~3), height(std::max(height, 1))
+    {
+        int w = this->width, h = this->height;
+        for (;;)
+        {
+            levelSizes.push_back({w, h});
+            minLevels.emplace_back((size_t) w * h, 1.0f);
+            maxLevels.emplace_back((size_t) w * h, 1.0f);
+            if (w == 1 && h == 1)
+                break;
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+        }
+    }
+
+    int Width() const { return width; }
+    int Height() const { return height; }
+    // the depth buffer after Rasterize, row 0 at the bottom
+    const float *Depth() const { return minLevels[0].data(); }
+
+    // starts a frame: clears the occluders and sets the camera
+    void Begin(const glm::mat4 &projectionView)
+    {
+        viewProjection = projectionView;
+        occluders.clear();
+        stats = OcclusionStats();
+    }
+
+    // the occluder has to stay alive until Rasterize
+    void AddOccluder(const OccluderMesh &occluder, const glm::mat4 &model)
+    {
+        occluders.push_back({&occluder, viewProjection * model});
+        stats.occluderTriangles += occluder.TriangleCount();
+    }
+
+    // draws the occluders and builds the depth hierarchy; without a pool everything runs on this thread
+    void Rasterize(ThreadPool *pool = &ThreadPool::Shared())
+    {
+        setupTriangles(pool);
+        int bands = pool ? std::min<int>(height, 2 * (pool->Size() + 1)) : 1;
+        int bandHeight = (height + bands - 1) / bands;
+        auto rasterizeBand = [&](size_t band) {
+            int y0 = (int) band * bandHeight, y1 = std::min(height, y0 + bandHeight);
+            std::fill(minLevels[0].begin() + (size_t) y0 * width, minLevels[0].begin() + (size_t) y1 * width, 1.0f);
+            for (const ScreenTriangle &triangle : triangles)
+                if (triangle.minY < y1 && triangle.maxY >= y0)
+                    rasterize(triangle, y0, y1);
+            for (const ScreenEdge &edge : outline)
+                if (edge.minY < y1 && edge.maxY >= y0)
+                    open(edge, y0, y1);
+        };
+        if (pool)
+            pool->ParallelFor(bands, rasterizeBand);
+        else
+            for (int band = 0; band < bands; band++)
+                rasterizeBand(band);
+        buildHierarchy();
+    }
+
+    // false if the box is certainly hidden behind the occluders; boxes reaching behind the camera count as visible.
+    // Only counts into the stats, so it can't be called from several threads at once.
+    bool IsVisible(const BoundingBox &box)
+    {
+        stats.tested++;
+        if (box.Empty())
+            return true;
+        float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY, nearest = INFINITY;
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 p((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y,
+                        (corner & 4) ? box.max.z : box.min.z);
+            glm::vec4 clip = viewProjection * glm::vec4(p, 1.0f);
+            if (clip.w <= OCCLUSION_NEAR_W)
+                return true;
+            float inverseW = 1.0f / clip.w;
+            float x = (clip.x * inverseW * 0.5f + 0.5f) * width, y = (clip.y * inverseW * 0.5f + 0.5f) * height;
+            minX = std::min(minX, x); maxX = std::max(maxX, x);
+            minY = std::min(minY, y); maxY = std::max(maxY, y);
+            nearest = std::min(nearest, clip.z * inverseW);
+        }
+        // the pixels whose centers the rectangle covers, widened by one so that thin boxes aren't lost between centers
+        minX = std::max(minX, -1.0f); maxX = std::min(maxX, (float) width + 1.0f);
+        minY = std::max(minY, -1.0f); maxY = std::min(maxY, (float) height + 1.0f);
+        int x0 = std::max(0, (int) std::floor(minX) - 1), x1 = std::min(width - 1, (int) std::ceil(maxX));
+        int y0 = std::max(0, (int) std::floor(minY) - 1), y1 = std::min(height - 1, (int) std::ceil(maxY));
+        if (x0 > x1 || y0 > y1)
+            return false;
+        int level = 0;
+        while (level + 1 < (int) levelSizes.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+            level++;
+        if (visibleIn(level, x0, y0, x1, y1, nearest))
+            return true;
+        stats.occluded++;
+        return false;
+    }
+
+    OcclusionStats Stats() const { return stats; }
+
+private:
+    struct Occluder {
+        const OccluderMesh *mesh;
+        glm::mat4 transform;
+    };
+
+    // in pixels, counter-clockwise, with NDC depth
+    struct ScreenTriangle {
+        float x[3], y[3], z[3];
+        int minX, maxX, minY, maxY;
+        // added to the depth at a pixel's center: how much farther the surface can get within the pixel
+        float depthBias;
+    };
+
+    // an outline edge in pixels, with the rows it touches
+    struct ScreenEdge {
+        float x0, y0, x1, y1;
+        int minY, maxY;
+    };
+
+    struct LevelSize {
+        int width, height;
+    };
+
+    int width, height;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    std::vector<Occluder> occluders;
+    std::vector<ScreenTriangle> triangles;
+    std::vector<ScreenEdge> outline;
+    // setupTriangles' output per occluder triangle, before the unused slots are dropped
+    std::vector<ScreenTriangle> triangleSlots;
+    std::vector<ScreenEdge> edgeSlots;
+    std::vector<uint8_t> triangleSlotUsed, edgeSlotUsed;
+    // per level: the nearest and farthest depth of the pixels each texel covers; level 0 is the depth buffer
+    std::vector<LevelSize> levelSizes;
+    std::vector<std::vector<float>> minLevels, maxLevels;
+    OcclusionStats stats;
+
+    // transforms, clips against the near plane and projects every occluder triangle, and finds the occluders' outlines
+    void setupTriangles(ThreadPool *pool)
+    {
+        // a clipped triangle becomes at most two, so each input triangle gets two slots, and four for its outline
+        std::vector<size_t> firstTriangle(occluders.size() + 1, 0);
+        for (size_t i = 0; i < occluders.size(); i++)
+            firstTriangle[i + 1] = firstTriangle[i] + occluders[i].mesh->TriangleCount();
+        // kept from frame to frame, so the memory isn't allocated (and faulted in) again each time
+        std::vector<ScreenTriangle> &slots = triangleSlots;
+        slots.resize(2 * firstTriangle.back());
+        edgeSlots.resize(4 * firstTriangle.back());
+        std::vector<uint8_t> &used = triangleSlotUsed;
+        used.assign(slots.size(), 0);
+        edgeSlotUsed.assign(edgeSlots.size(), 0);
+        auto setupOccluder = [&](size_t i) {
+            const Occluder &occluder = occluders[i];
+            const OccluderMesh &mesh = *occluder.mesh;
+            size_t triangleCount = mesh.TriangleCount();
+            std::vector<glm::vec4> clip(3 * triangleCount);
+            // which way each triangle faces on screen (1 or -1); 0 where the near plane cuts it or it has no area
+            std::vector<int8_t> facing(triangleCount, 0);
+            std::vector<float> areas(triangleCount, 0.0f), slopes(triangleCount, 0.0f);
+            for (size_t t = 0; t < triangleCount; t++)
+            {
+                for (int corner = 0; corner < 3; corner++)
+                    clip[3 * t + corner] = occluder.transform * glm::vec4(mesh.positions[mesh.indices[3 * t + corner]], 1.0f);
+                if (cut(&clip[3 * t]))
+                    continue;
+                const glm::vec4 *corners[3] = {&clip[3 * t], &clip[3 * t + 1], &clip[3 * t + 2]};
+                ScreenTriangle &triangle = slots[2 * (firstTriangle[i] + t)];
+                areas[t] = screenTriangle(corners, triangle);
+                if (areas[t] != 0.0f)
+                    facing[t] = areas[t] > 0.0f ? 1 : -1;
+                slopes[t] = triangle.depthBias;
+            }
+
+            bool linked = mesh.neighbours.size() == mesh.indices.size();
+            for (size_t t = 0; t < triangleCount; t++)
+            {
+                size_t slot = firstTriangle[i] + t;
+                glm::vec4 polygon[4];
+                int corners = 3;
+                if (facing[t] != 0)
+                {
+                    // across an edge inside the surface, the depth within a pixel can go on at the neighbour's slope
+                    ScreenTriangle &triangle = slots[2 * slot];
+                    float neighbourSlope = 0.0f;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        int32_t neighbour = linked ? mesh.neighbours[3 * t + k] : -1;
+                        if (neighbour >= 0 && facing[neighbour] == facing[t])
+                            neighbourSlope = std::max(neighbourSlope, slopes[neighbour]);
+                    }
+                    if (place(triangle, areas[t]))
+                    {
+                        triangle.depthBias += neighbourSlope;
+                        used[2 * slot] = 1;
+                    }
+                    std::copy(&clip[3 * t], &clip[3 * t] + 3, polygon);
+                }
+                else if (cut(&clip[3 * t]))
+                {
+                    corners = clipNear(&clip[3 * t], polygon);
+                    for (int k = 1; k + 1 < corners; k++)
+                    {
+                        const glm::vec4 *fan[3] = {&polygon[0], &polygon[k], &polygon[k + 1]};
+                        if (project(fan, slots[2 * slot + k - 1]))
+                            used[2 * slot + k - 1] = 1;
+                    }
+                }
+                else
+                {
+                    // no area on screen: its neighbours draw the outline around it
+                    continue;
+                }
+
+                for (int k = 0; k < corners; k++)
+                {
+                    // an edge between two triangles facing the same way is inside the surface on screen
+                    int32_t neighbour = linked && facing[t] != 0 ? mesh.neighbours[3 * t + k] : -1;
+                    if (neighbour >= 0 && facing[neighbour] == facing[t])
+                        continue;
+                    if (projectEdge(polygon[k], polygon[(k + 1) % corners], edgeSlots[4 * slot + k]))
+                        edgeSlotUsed[4 * slot + k] = 1;
+                }
+            }
+        };
+        if (pool)
+            pool->ParallelFor(occluders.size(), setupOccluder);
+        else
+            for (size_t i = 0; i < occluders.size(); i++)
+                setupOccluder(i);
+
+        triangles.clear();
+        for (size_t i = 0; i < slots.size(); i++)
+            if (used[i])
+                triangles.push_back(slots[i]);
+        outline.clear();
+        for (size_t i = 0; i < edgeSlots.size(); i++)
+            if (edgeSlotUsed[i])
+                outline.push_back(edgeSlots[i]);
+        stats.rasterizedTriangles = triangles.size();
+    }
+
+    // whether the near plane cuts into the triangle
+    static bool cut(const glm::vec4 clip[3])
+    {
+        return clip[0].z + clip[0].w < 0.0f || clip[1].z + clip[1].w < 0.0f || clip[2].z + clip[2].w < 0.0f;
+    }
+
+    // clips a triangle against the near plane (z >= -w); returns the corners left (0, 3 or 4), in order
+    static int clipNear(const glm::vec4 clip[3], glm::vec4 polygon[4])
+    {
+        int count = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            const glm::vec4 &a = clip[i], &b = clip[(i + 1) % 3];
+            float da = a.z + a.w, db = b.z + b.w;
+            if (da >= 0.0f)
+                polygon[count++] = a;
+            if ((da >= 0.0f) != (db >= 0.0f))
+                polygon[count++] = a + (b - a) * (da / (da - db));
+        }
+        return count;
+    }
+
+    glm::vec2 toScreen(const glm::vec4 &clip) const
+    {
+        float w = std::max(clip.w, OCCLUSION_NEAR_W);
+        return glm::vec2((clip.x / w * 0.5f + 0.5f) * width, (clip.y / w * 0.5f + 0.5f) * height);
+    }
+
+    // false if the edge misses the screen
+    bool projectEdge(const glm::vec4 &from, const glm::vec4 &to, ScreenEdge &edge) const
+    {
+        // a little wider than the edge, so rounding in open() can't miss a pixel it only grazes
+        const float SLACK = 1e-3f;
+        glm::vec2 a = toScreen(from), b = toScreen(to);
+        if (!std::isfinite(a.x + a.y + b.x + b.y) || std::max(a.x, b.x) < -SLACK || std::min(a.x, b.x) > width + SLACK)
+            return false;
+        edge.x0 = a.x; edge.y0 = a.y;
+        edge.x1 = b.x; edge.y1 = b.y;
+        edge.minY = std::max(0, (int) std::floor(std::min(a.y, b.y) - SLACK));
+        edge.maxY = std::min(height - 1, (int) std::floor(std::max(a.y, b.y) + SLACK));
+        return edge.minY <= edge.maxY;
+    }
+
+    // the corners in pixels, as given, and depthBias as how much the depth changes within half a pixel in x and y.
+    // Returns twice the signed area (negative when clockwise), 0 if the triangle is unusable.
+    float screenTriangle(const glm::vec4 *const corners[3], ScreenTriangle &triangle) const
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            glm::vec2 screen = toScreen(*corners[i]);
+            triangle.x[i] = screen.x;
+            triangle.y[i] = screen.y;
+            triangle.z[i] = corners[i]->z / std::max(corners[i]->w, OCCLUSION_NEAR_W);
+        }
+        float area = edge(triangle, 0, 1, triangle.x[2], triangle.y[2]);
+        if (area == 0.0f || !std::isfinite(area))
+            return 0.0f;
+        const ScreenTriangle &t = triangle;
+        float depthX = ((t.z[1] - t.z[0]) * (t.y[2] - t.y[0]) - (t.z[2] - t.z[0]) * (t.y[1] - t.y[0])) / area;
+        float depthY = ((t.z[2] - t.z[0]) * (t.x[1] - t.x[0]) - (t.z[1] - t.z[0]) * (t.x[2] - t.x[0])) / area;
+        float slope = 0.5f * (std::abs(depthX) + std::abs(depthY));
+        if (!std::isfinite(slope))
+            return 0.0f;
+        triangle.depthBias = slope;
+        return area;
+    }
+
+    // the triangle ready to rasterize; false if it has no area or misses the screen
+    bool project(const glm::vec4 *const corners[3], ScreenTriangle &triangle) const
+    {
+        float area = screenTriangle(corners, triangle);
+        return area != 0.0f && place(triangle, area);
+    }
+
+    // turns a triangle from screenTriangle with its signed area counter-clockwise and finds the pixels it can cover;
+    // false if it misses the screen
+    bool place(ScreenTriangle &triangle, float area) const
+    {
+        // both sides occlude: make every triangle counter-clockwise
+        if (area < 0.0f)
+        {
+            std::swap(triangle.x[1], triangle.x[2]);
+            std::swap(triangle.y[1], triangle.y[2]);
+            std::swap(triangle.z[1], triangle.z[2]);
+        }
+        // pixels whose centers can be inside
+        float minX = std::min({triangle.x[0], triangle.x[1], triangle.x[2]});
+        float maxX = std::max({triangle.x[0], triangle.x[1], triangle.x[2]});
+        float minY = std::min({triangle.y[0], triangle.y[1], triangle.y[2]});
+        float maxY = std::max({triangle.y[0], triangle.y[1], triangle.y[2]});
+        triangle.minX = std::max(0, (int) std::ceil(minX - 0.5f));
+        triangle.maxX = std::min(width - 1, (int) std::floor(maxX - 0.5f));
+        triangle.minY = std::max(0, (int) std::ceil(minY - 0.5f));
+        triangle.maxY = std::min(height - 1, (int) std::floor(maxY - 0.5f));
+        return triangle.minX <= triangle.maxX && triangle.minY <= triangle.maxY;
+    }
+
+    // twice the signed area of (a, b, p); positive when p is left of a -> b
+    static float edge(const ScreenTriangle &t, int a, int b, float px, float py)
+    {
+        return (t.x[b] - t.x[a]) * (py - t.y[a]) - (t.y[b] - t.y[a]) * (px - t.x[a]);
+    }
+
+    // the rows [y0, y1) of the triangle; pixels keep the nearest depth
+    void rasterize(const ScreenTriangle &t, int y0, int y1)
+    {
+        // barycentric weights as edge functions: w0 is opposite vertex 0, ...; each is linear in x
+        float area = edge(t, 0, 1, t.x[2], t.y[2]);
+        float inverseArea = 1.0f / area;
+        float stepX[3] = {-(t.y[2] - t.y[1]), -(t.y[0] - t.y[2]), -(t.y[1] - t.y[0])};
+        int rowStart = std::max(y0, t.minY), rowEnd = std::min(y1 - 1, t.maxY);
+        // spans start on a multiple of 4 so they line up with the SIMD width
+        int spanStart = t.minX & ~3;
+        for (int y = rowStart; y <= rowEnd; y++)
+        {
+            float py = y + 0.5f, px = spanStart + 0.5f;
+            float w0 = edge(t, 1, 2, px, py), w1 = edge(t, 2, 0, px, py), w2 = edge(t, 0, 1, px, py);
+            float *row = minLevels[0].data() + (size_t) y * width;
+#if defined(__SSE2__)
+            const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+            const __m128 zero = _mm_setzero_ps();
+            const __m128 z0 = _mm_set1_ps(t.z[0] * inverseArea);
+            const __m128 z1 = _mm_set1_ps(t.z[1] * inverseArea);
+            const __m128 z2 = _mm_set1_ps(t.z[2] * inverseArea);
+            const __m128 bias = _mm_set1_ps(t.depthBias);
+            __m128 e0 = _mm_add_ps(_mm_set1_ps(w0), _mm_mul_ps(lanes, _mm_set1_ps(stepX[0])));
+            __m128 e1 = _mm_add_ps(_mm_set1_ps(w1), _mm_mul_ps(lanes, _mm_set1_ps(stepX[1])));
+            __m128 e2 = _mm_add_ps(_mm_set1_ps(w2), _mm_mul_ps(lanes, _mm_set1_ps(stepX[2])));
+            const __m128 step0 = _mm_set1_ps(4.0f * stepX[0]);
+            const __m128 step1 = _mm_set1_ps(4.0f * stepX[1]);
+            const __m128 step2 = _mm_set1_ps(4.0f * stepX[2]);
+            for (int x = spanStart; x <= t.maxX; x += 4)
+            {
+                __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                if (_mm_movemask_ps(inside))
+                {
+                    __m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e0, z0), _mm_mul_ps(e1, z1)), _mm_mul_ps(e2, z2));
+                    depth = _mm_add_ps(depth, bias);
+                    __m128 current = _mm_loadu_ps(row + x);
+                    __m128 nearer = _mm_min_ps(current, depth);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+                }
+                e0 = _mm_add_ps(e0, step0);
+                e1 = _mm_add_ps(e1, step1);
+                e2 = _mm_add_ps(e2, step2);
+            }
+#else
+            for (int x = spanStart; x <= t.maxX; x++)
+            {
+                if (w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f)
+                    row[x] = std::min(row[x], (w0 * t.z[0] + w1 * t.z[1] + w2 * t.z[2]) * inverseArea + t.depthBias);
+                w0 += stepX[0];
+                w1 += stepX[1];
+                w2 += stepX[2];
+            }
+#endif
+        }
+    }
+
+    // empties the pixels in rows [y0, y1) that the edge passes through
+    void open(const ScreenEdge &e, int y0, int y1)
+    {
+        const float SLACK = 1e-3f;
+        int rowStart = std::max(y0, e.minY), rowEnd = std::min(y1 - 1, e.maxY);
+        float dy = e.y1 - e.y0;
+        for (int y = rowStart; y <= rowEnd; y++)
+        {
+            // the part of the edge inside the row
+            float xa = e.x0, xb = e.x1;
+            if (dy != 0.0f)
+            {
+                float ta = std::min(std::max((y - e.y0) / dy, 0.0f), 1.0f);
+                float tb = std::min(std::max((y + 1 - e.y0) / dy, 0.0f), 1.0f);
+                xa = e.x0 + (e.x1 - e.x0) * ta;
+                xb = e.x0 + (e.x1 - e.x0) * tb;
+            }
+            int x0 = std::max(0, (int) std::floor(std::min(xa, xb) - SLACK));
+            int x1 = std::min(width - 1, (int) std::floor(std::max(xa, xb) + SLACK));
+            float *row = minLevels[0].data() + (size_t) y * width;
+            for (int x = x0; x <= x1; x++)
+                row[x] = 1.0f;
+        }
+    }
+
+    // level 0's max is its min (one pixel per texel); each level above reduces 2x2 texels of the one below
+    void buildHierarchy()
+    {
+        maxLevels[0] = minLevels[0];
+        for (size_t level = 1; level < levelSizes.size(); level++)
+        {
+            const LevelSize &below = levelSizes[level - 1], &size = levelSizes[level];
+            for (int y = 0; y < size.height; y++)
+            {
+                int ya = std::min(2 * y, below.height - 1), yb = std::min(2 * y + 1, below.height - 1);
+                for (int x = 0; x < size.width; x++)
+                {
+                    int xa = std::min(2 * x, below.width - 1), xb = std::min(2 * x + 1, below.width - 1);
+                    size_t i[4] = {(size_t) ya * below.width + xa, (size_t) ya * below.width + xb,
+                                   (size_t) yb * below.width + xa, (size_t) yb * below.width + xb};
+                    const std::vector<float> &mins = minLevels[level - 1], &maxs = maxLevels[level - 1];
+                    minLevels[level][(size_t) y * size.width + x] = std::min({mins[i[0]], mins[i[1]], mins[i[2]], mins[i[3]]});
+                    maxLevels[level][(size_t) y * size.width + x] = std::max({maxs[i[0]], maxs[i[1]], maxs[i[2]], maxs[i[3]]});
+                }
+            }
+        }
+    }
+
+    // whether the pixels [x0, x1] x [y0, y1] have one that the depth `nearest` is in front of, looking only at the
+    // texels of `level` over them and descending only where their min and max don't decide it
+    bool visibleIn(int level, int x0, int y0, int x1, int y1, float nearest) const
+    {
+        const LevelSize &size = levelSizes[level];
+        for (int ty = y0 >> level; ty <= (y1 >> level); ty++)
+        {
+            for (int tx = x0 >> level; tx <= (x1 >> level); tx++)
+            {
+                size_t i = (size_t) ty * size.width + tx;
+                if (nearest > maxLevels[level][i])
+                    continue;
+                if (nearest <= minLevels[level][i] || level == 0)
+                    return true;
+                int childX0 = std::max(x0, tx << level), childX1 = std::min(x1, ((tx + 1) << level) - 1);
+                int childY0 = std::max(y0, ty << level), childY1 = std::min(y1, ((ty + 1) << level) - 1);
+                if (visibleIn(level - 1, childX0, childY0, childX1, childY1, nearest))
+                    return true;
+            }
+        }
+        return false;
+    }
+};
+#endif
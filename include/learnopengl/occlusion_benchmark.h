@@ -0,0 +1,187 @@
+#ifndef OCCLUSION_BENCHMARK_H
+#define OCCLUSION_BENCHMARK_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/bounds.h>
+#include <learnopengl/occlusion.h>
+#include <learnopengl/thread_pool.h>
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// CPU-only timings of OcclusionCuller: a row of wall segments in front of the camera (occluders, each split into
+// many triangles like a real mesh would be) and boxes scattered behind and around them. Reports rasterization on
+// one thread and on the pool, box tests per second and how many boxes the walls hid.
+inline void RunOcclusionBenchmark(int width, int height, size_t boxCount)
+{
+    typedef std::chrono::steady_clock Clock;
+    auto milliseconds = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+    const int REPEATS = 20;
+
+    // a 16 x 16 grid of quads per wall
+    OccluderMesh wall;
+    const int CELLS = 16;
+    for (int y = 0; y <= CELLS; y++)
+        for (int x = 0; x <= CELLS; x++)
+            wall.positions.push_back(glm::vec3((float) x / CELLS - 0.5f, (float) y / CELLS - 0.5f, 0.0f));
+    for (int y = 0; y < CELLS; y++)
+    {
+        for (int x = 0; x < CELLS; x++)
+        {
+            uint32_t corner = y * (CELLS + 1) + x;
+            uint32_t quad[6] = {corner, corner + 1, corner + CELLS + 2, corner, corner + CELLS + 2, corner + CELLS + 1};
+            wall.indices.insert(wall.indices.end(), quad, quad + 6);
+        }
+    }
+    wall.FindNeighbours();
+    std::vector<glm::mat4> walls;
+    for (int i = -4; i <= 4; i++)
+    {
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(i * 3.0f, 0.0f, -10.0f - (i & 1) * 2.0f));
+        walls.push_back(glm::scale(transform, glm::vec3(2.8f, 6.0f, 1.0f)));
+    }
+
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<BoundingBox> boxes(boxCount);
+    for (BoundingBox &box : boxes)
+    {
+        glm::vec3 center((unit(random) - 0.5f) * 40.0f, (unit(random) - 0.5f) * 8.0f, -12.0f - unit(random) * 60.0f);
+        glm::vec3 extents = glm::vec3(0.2f) + glm::vec3(unit(random), unit(random), unit(random)) * 0.8f;
+        box.min = center - extents;
+        box.max = center + extents;
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), (float) width / height, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    OcclusionCuller culler(width, height);
+
+    double rasterize[2];
+    for (int pooled = 0; pooled < 2; pooled++)
+    {
+        Clock::time_point start = Clock::now();
+        for (int repeat = 0; repeat < REPEATS; repeat++)
+        {
+            culler.Begin(projection * view);
+            for (const glm::mat4 &transform : walls)
+                culler.AddOccluder(wall, transform);
+            culler.Rasterize(pooled ? &ThreadPool::Shared() : nullptr);
+        }
+        rasterize[pooled] = milliseconds(start) / REPEATS;
+    }
+
+    size_t visible = 0;
+    Clock::time_point start = Clock::now();
+    for (const BoundingBox &box : boxes)
+        visible += culler.IsVisible(box);
+    double testTime = milliseconds(start);
+
+    OcclusionStats stats = culler.Stats();
+    std::ios::fmtflags flags = std::cout.flags();
+    std::streamsize precision = std::cout.precision();
+    std::cout << "depth buffer " << culler.Width() << "x" << culler.Height() << ", " << stats.occluderTriangles
+              << " occluder triangles (" << stats.rasterizedTriangles << " rasterized)" << std::endl;
+    std::cout << std::fixed << std::setprecision(3) << "rasterize + hierarchy: " << rasterize[0] << " ms on 1 thread, "
+              << rasterize[1] << " ms on " << ThreadPool::Shared().Size() + 1 << std::endl;
+    std::cout << std::setprecision(2) << "box tests: " << boxCount / (testTime * 1000.0) << " M/s, "
+              << boxCount - visible << " of " << boxCount << " boxes hidden" << std::endl;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
+
+// Headless correctness checks of OcclusionCuller, on one thread and on the pool; prints each failure and returns
+// whether all passed. Looks straight down -z at walls 5 units away:
+//  - a box behind a wall covering the screen is culled, one in front of it is not;
+//  - a box behind a wall covering the left half of the screen is culled, one beside the wall is not;
+//  - the same wall split into many triangles still culls (the seams between them are no outline);
+//  - a box seen only through a gap between two walls narrower than a depth buffer pixel, with every pixel center
+//    around it covered, is not culled.
+inline bool RunOcclusionCheck(int width = 256, int height = 128)
+{
+    const float FOV = 60.0f, WALL = 5.0f, BEHIND = 10.0f;
+    float aspect = (float) width / height;
+    glm::mat4 projection = glm::perspective(glm::radians(FOV), aspect, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    // the world x seen at a depth buffer column (in pixels, fractional) at a distance
+    float halfWidth = aspect * std::tan(glm::radians(FOV) * 0.5f);
+    auto worldX = [&](float pixel, float distance) { return (pixel / width * 2.0f - 1.0f) * halfWidth * distance; };
+
+    // a wall from x0 to x1, far beyond the screen in y, in cells x cells triangle pairs
+    auto makeWall = [&](float x0, float x1, int cells) {
+        OccluderMesh wall;
+        for (int y = 0; y <= cells; y++)
+            for (int x = 0; x <= cells; x++)
+                wall.positions.push_back(glm::vec3(x0 + (x1 - x0) * x / cells, 100.0f * ((float) y / cells - 0.5f), -WALL));
+        for (int y = 0; y < cells; y++)
+        {
+            for (int x = 0; x < cells; x++)
+            {
+                uint32_t corner = y * (cells + 1) + x;
+                uint32_t quad[6] = {corner, corner + 1, corner + cells + 2, corner, corner + cells + 2, corner + cells + 1};
+                wall.indices.insert(wall.indices.end(), quad, quad + 6);
+            }
+        }
+        wall.FindNeighbours();
+        return wall;
+    };
+    auto makeBox = [](float x0, float x1, float distance, float depth) {
+        BoundingBox box;
+        box.min = glm::vec3(x0, -0.5f, -distance - depth);
+        box.max = glm::vec3(x1, 0.5f, -distance);
+        return box;
+    };
+
+    OccluderMesh fullScreen = makeWall(-100.0f, 100.0f, 1);
+    OccluderMesh leftHalf = makeWall(-100.0f, 0.0f, 1);
+    OccluderMesh leftHalfTessellated = makeWall(worldX(0.0f, WALL) - 1.0f, 0.0f, 24);
+    // pixel centers at 129.5 and 130.5 are covered, the gap between the walls is 129.6 to 129.9
+    OccluderMesh gapLeft = makeWall(-100.0f, worldX(129.6f, WALL), 1);
+    OccluderMesh gapRight = makeWall(worldX(129.9f, WALL), 100.0f, 1);
+    float gapX = worldX(129.75f, BEHIND), gapHalf = worldX(129.8f, BEHIND) - gapX;
+
+    struct Case {
+        const char *name;
+        std::vector<const OccluderMesh*> occluders;
+        BoundingBox box;
+        bool visible;
+    };
+    std::vector<Case> cases = {
+        {"behind a full-screen wall", {&fullScreen}, makeBox(-1.0f, 1.0f, BEHIND, 1.0f), false},
+        {"in front of a full-screen wall", {&fullScreen}, makeBox(-1.0f, 1.0f, 3.0f, 1.0f), true},
+        {"behind a half-screen wall", {&leftHalf}, makeBox(-3.0f, -1.0f, BEHIND, 1.0f), false},
+        {"beside a half-screen wall", {&leftHalf}, makeBox(1.0f, 3.0f, BEHIND, 1.0f), true},
+        {"behind a tessellated wall", {&leftHalfTessellated}, makeBox(-3.0f, -1.0f, BEHIND, 1.0f), false},
+        {"behind a gap narrower than a pixel", {&gapLeft, &gapRight}, makeBox(gapX - gapHalf, gapX + gapHalf, BEHIND, 1.0f), true},
+    };
+
+    bool passed = true;
+    OcclusionCuller culler(width, height);
+    for (int pooled = 0; pooled < 2; pooled++)
+    {
+        for (const Case &test : cases)
+        {
+            culler.Begin(projection * view);
+            for (const OccluderMesh *occluder : test.occluders)
+                culler.AddOccluder(*occluder, glm::mat4(1.0f));
+            culler.Rasterize(pooled ? &ThreadPool::Shared() : nullptr);
+            if (culler.IsVisible(test.box) != test.visible)
+            {
+                std::cout << "occlusion check failed (" << (pooled ? "pool" : "one thread") << "): box " << test.name
+                          << " was " << (test.visible ? "culled" : "not culled") << std::endl;
+                passed = false;
+            }
+        }
+    }
+    if (passed)
+        std::cout << "occlusion check passed: " << 2 * cases.size() << " cases" << std::endl;
+    return passed;
+}
+#endif
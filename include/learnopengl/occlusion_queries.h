@@ -0,0 +1,232 @@
+#ifndef OCCLUSION_QUERIES_H
+#define OCCLUSION_QUERIES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/bounds.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/shader.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct OcclusionQueryStats {
+    // proxies drawn this frame, objects Visible() reported hidden, and draws handed to conditional rendering
+    size_t issued = 0, hidden = 0, conditional = 0;
+};
+
+// GPU occlusion queries (GL_ANY_SAMPLES_PASSED) on bounding box proxies, one query per object. Objects are dense ids
+// picked by the caller (the meshes of a model, the instances of a scene). Proxies are drawn after the frame's
+// geometry, so each box is tested against the finished depth buffer, and its result is used in a later frame.
+// Nothing ever waits for the GPU:
+//  - Visible() picks up results that have arrived and keeps the last one known, so hidden objects can be left out
+//    on the CPU (also for instanced draws, where the GPU can't skip one instance);
+//  - ConditionQuery() gives a query to draw the object under glBeginConditionalRender(GL_QUERY_NO_WAIT): the GPU skips
+//    the draw when the last test saw no samples and draws it when the result isn't there yet. No readback at all.
+// Results are a frame late, so an object coming out from behind an occluder may appear a frame after it should.
+class OcclusionQueries
+{
+public:
+    // results older than this many frames (the object wasn't tested lately) count as visible
+    enum { MAX_RESULT_AGE = 4 };
+
+    OcclusionQueries() = default;
+    OcclusionQueries(const OcclusionQueries&) = delete;
+    OcclusionQueries &operator=(const OcclusionQueries&) = delete;
+
+    ~OcclusionQueries()
+    {
+        for (const Query &query : queries)
+            if (query.id)
+                glDeleteQueries(1, &query.id);
+        if (proxyVAO)
+        {
+            GLState::Instance().DeleteVertexArray(proxyVAO);
+            GLState::Instance().DeleteBuffer(proxyVBO);
+            GLState::Instance().DeleteBuffer(proxyEBO);
+        }
+    }
+
+    // objects with fewer triangles aren't worth a query: their proxy costs about as much as drawing them
+    void SetMinTriangles(size_t value) { minTriangles = value; }
+    size_t MinTriangles() const { return minTriangles; }
+
+    // forgets every result, and any query in flight, e.g. when the ids are reused for other objects. The query objects
+    // are kept; beginning one again discards its old result.
+    void Reset()
+    {
+        for (Query &query : queries)
+        {
+            query.pending = false;
+            query.visible = true;
+            query.resultFrame = 0;
+            query.issuedFrame = 0;
+        }
+    }
+
+    // call once per frame before any Visible or ConditionQuery
+    void NewFrame()
+    {
+        frame++;
+        stats = OcclusionQueryStats();
+    }
+
+    // false only when the object's last recent test saw no samples
+    bool Visible(uint32_t object)
+    {
+        if (object >= queries.size())
+            return true;
+        Query &query = queries[object];
+        poll(query);
+        bool visible = query.visible || frame - query.resultFrame > MAX_RESULT_AGE;
+        stats.hidden += !visible;
+        return visible;
+    }
+
+    // the query to make a draw of the object conditional on, or 0 when it should be drawn unconditionally
+    GLuint ConditionQuery(uint32_t object)
+    {
+        if (object >= queries.size())
+            return 0;
+        const Query &query = queries[object];
+        if (!query.issuedFrame || frame - query.issuedFrame > MAX_RESULT_AGE)
+            return 0;
+        stats.conditional++;
+        return query.id;
+    }
+
+    // starts drawing proxies: color and depth writes are off until EndProxies. Call after the frame's geometry.
+    // nearMargin: how close the eye may come to a box before the near plane can cut into its front faces (at least the
+    // distance to the near plane's corners); objects that close are simply visible.
+    void BeginProxies(const glm::mat4 &projView, const glm::vec3 &viewPosition, float nearMargin)
+    {
+        if (!proxyShader)
+            createProxy();
+        proxyShader->use();
+        proxyShader->setMat4(projViewUniform, projView);
+        GLState::Instance().BindVertexArray(proxyVAO);
+        GLState::Instance().DepthMask(false);
+        GLState::Instance().ColorMask(false);
+        eye = viewPosition;
+        margin = nearMargin;
+    }
+
+    // tests box (world space) for the object, unless its previous test is still in flight
+    void Test(uint32_t object, const BoundingBox &box)
+    {
+        if (object >= queries.size())
+            queries.resize(object + 1);
+        Query &query = queries[object];
+        if (!poll(query))
+            return;
+        if (nearEye(box))
+        {
+            query.visible = true;
+            query.resultFrame = frame;
+            query.issuedFrame = 0;
+            return;
+        }
+        if (!query.id)
+            glGenQueries(1, &query.id);
+        // grown a little, so faces of the object lying on the box don't fail the depth test against themselves
+        glm::vec3 grow = (box.max - box.min) * 1e-3f + glm::vec3(1e-4f);
+        proxyShader->setVec3(boxMinUniform, box.min - grow);
+        proxyShader->setVec3(boxSizeUniform, box.max - box.min + 2.0f * grow);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, query.id);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, 0);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        query.pending = true;
+        query.issuedFrame = frame;
+        stats.issued++;
+    }
+
+    void EndProxies()
+    {
+        GLState::Instance().ColorMask(true);
+        GLState::Instance().DepthMask(true);
+    }
+
+    const OcclusionQueryStats &Stats() const { return stats; }
+
+private:
+    struct Query {
+        GLuint id = 0;
+        // begun and not read back yet
+        bool pending = false;
+        bool visible = true;
+        // frame of the test the result / the query in flight belongs to; 0: none
+        uint64_t resultFrame = 0, issuedFrame = 0;
+    };
+
+    std::vector<Query> queries;
+    size_t minTriangles = 512;
+    uint64_t frame = 0;
+    OcclusionQueryStats stats;
+    glm::vec3 eye = glm::vec3(0.0f);
+    float margin = 0.0f;
+
+    // unit cube drawn scaled to each box
+    std::unique_ptr<Shader> proxyShader;
+    UniformHandle projViewUniform, boxMinUniform, boxSizeUniform;
+    unsigned int proxyVAO = 0, proxyVBO = 0, proxyEBO = 0;
+
+    bool nearEye(const BoundingBox &box) const
+    {
+        for (int axis = 0; axis < 3; axis++)
+            if (eye[axis] < box.min[axis] - margin || eye[axis] > box.max[axis] + margin)
+                return false;
+        return true;
+    }
+
+    // takes the result of a query in flight if the GPU has it, without waiting; false while it's still pending
+    bool poll(Query &query)
+    {
+        if (!query.pending)
+            return true;
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return false;
+        GLuint samples = 0;
+        glGetQueryObjectuiv(query.id, GL_QUERY_RESULT, &samples);
+        query.pending = false;
+        query.visible = samples != 0;
+        query.resultFrame = query.issuedFrame;
+        return true;
+    }
+
+    void createProxy()
+    {
+        proxyShader.reset(new Shader("resources/shaders/occlusion_proxy.vs", "resources/shaders/occlusion_proxy.fs"));
+        projViewUniform = proxyShader->uniform("projView");
+        boxMinUniform = proxyShader->uniform("boxMin");
+        boxSizeUniform = proxyShader->uniform("boxSize");
+
+        // corner i is (i & 1, i >> 1 & 1, i >> 2 & 1)
+        float corners[8 * 3];
+        for (int i = 0; i < 8; i++)
+        {
+            corners[i * 3 + 0] = (float) (i & 1);
+            corners[i * 3 + 1] = (float) (i >> 1 & 1);
+            corners[i * 3 + 2] = (float) (i >> 2 & 1);
+        }
+        const GLubyte indices[36] = {
+            0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  // z = 0, z = 1
+            0, 1, 4, 1, 5, 4,  2, 6, 3, 3, 6, 7,  // y = 0, y = 1
+            0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5,  // x = 0, x = 1
+        };
+        glGenVertexArrays(1, &proxyVAO);
+        glGenBuffers(1, &proxyVBO);
+        glGenBuffers(1, &proxyEBO);
+        GLState::Instance().BindVertexArray(proxyVAO);
+        GLState::Instance().BindBuffer(GL_ARRAY_BUFFER, proxyVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        GLState::Instance().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, proxyEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*) 0);
+    }
+};
+#endif
@@ -0,0 +1,151 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <common.h>
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/gl_state.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+const char PROGRAM_CACHE_MAGIC[6] = {'R', 'G', 'P', 'R', 'O', 'G'};
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary), one file per program under
+// cacheDirectory()/shaders. The key covers every stage's source and the driver's vendor, renderer and version
+// strings, since a binary is only valid for the driver that produced it. Drivers may still reject a binary
+// (e.g. after an update that kept the version string); Load then fails and the caller compiles from source.
+class ProgramBinaryCache
+{
+public:
+    // needs GLExtensions::Load and at least one binary format
+    static bool Supported()
+    {
+        static bool supported = detect();
+        return supported;
+    }
+
+    static uint64_t Key(const std::vector<std::string> &sources)
+    {
+        uint64_t key = hashBytes(&PROGRAM_CACHE_VERSION, sizeof(PROGRAM_CACHE_VERSION));
+        for (const std::string &source : sources)
+        {
+            // the length separates the stages, so moving text from one stage to the next changes the key
+            uint64_t length = source.size();
+            key = hashBytes(&length, sizeof(length), key);
+            key = hashString(source, key);
+        }
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        {
+            const char *value = reinterpret_cast<const char*>(glGetString(name));
+            key = hashString(value ? value : "", key);
+        }
+        return key;
+    }
+
+    // a linked program made from the cached binary, or 0 (no entry, or the driver rejected it)
+    static GLuint Load(uint64_t key)
+    {
+        if (!Supported())
+            return 0;
+        std::string path = pathFor(key);
+        std::string contents = readFileContents(path);
+        Header header{};
+        if (contents.size() < sizeof(Header))
+            return 0;
+        std::memcpy(&header, contents.data(), sizeof(Header));
+        if (std::memcmp(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic)) != 0 || header.version != PROGRAM_CACHE_VERSION ||
+            header.key != key || header.length != contents.size() - sizeof(Header))
+            return 0;
+
+        GLuint program = glCreateProgram();
+        GLExtensions::Functions().ProgramBinary(program, header.format, contents.data() + sizeof(Header), (GLsizei) header.length);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            // stale for this driver: drop it, the caller relinks from source and stores a fresh one
+            GLState::Instance().DeleteProgram(program);
+            std::remove(path.c_str());
+            return 0;
+        }
+        return program;
+    }
+
+    // call before glLinkProgram on programs that are going to be stored
+    static void MarkRetrievable(GLuint program)
+    {
+        if (Supported())
+            GLExtensions::Functions().ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // stores a successfully linked program
+    static bool Store(GLuint program, uint64_t key)
+    {
+        if (!Supported())
+            return false;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+        std::vector<char> binary(length);
+        Header header{};
+        std::memcpy(header.magic, PROGRAM_CACHE_MAGIC, sizeof(header.magic));
+        header.version = PROGRAM_CACHE_VERSION;
+        header.key = key;
+        GLsizei written = 0;
+        GLExtensions::Functions().GetProgramBinary(program, length, &written, &header.format, binary.data());
+        if (written <= 0)
+            return false;
+        header.length = (uint64_t) written;
+
+        std::string directory = cacheDirectory() + "/shaders";
+        if (!createDirectories(directory))
+            return false;
+        std::string path = pathFor(key);
+        // written under a temporary name and renamed, so a concurrent or crashed writer never leaves a partial file behind
+        std::string tmpPath = path + ".tmp";
+        FILE *out = std::fopen(tmpPath.c_str(), "wb");
+        if (!out)
+            return false;
+        bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1 && std::fwrite(binary.data(), written, 1, out) == 1;
+        ok = std::fclose(out) == 0 && ok;
+        if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct Header {
+        char magic[6];
+        uint32_t version;
+        GLenum format;
+        uint64_t key;
+        uint64_t length;
+    };
+
+    static bool detect()
+    {
+        const GLExtensionFunctions &f = GLExtensions::Functions();
+        if (!f.GetProgramBinary || !f.ProgramBinary || !f.ProgramParameteri)
+            return false;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    static std::string pathFor(uint64_t key)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long) key);
+        return cacheDirectory() + "/shaders/" + name;
+    }
+};
+#endif
@@ -0,0 +1,499 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/instance_buffer.h>
+#include <learnopengl/material.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/uniform_buffer.h>
+
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// one mesh to draw this frame
+struct DrawPacket {
+    Mesh *mesh = nullptr;
+    Shader *shader = nullptr;
+    // applies the set's shared uniforms when the program is switched to; may be null
+    ShaderVariants *variants = nullptr;
+    // index returned by RenderQueue::AddObject
+    uint32_t object = 0;
+    // distance from the camera, for front-to-back (opaque) and back-to-front (translucent) order
+    float depth = 0.0f;
+    // which of the mesh's LODs to draw (Mesh::LODCount)
+    unsigned int lod = 0;
+    // nonzero: an occlusion query the draw is made conditional on (OcclusionQueries::ConditionQuery); such draws are
+    // never merged into multi-draws
+    GLuint conditionQuery = 0;
+};
+
+struct RenderQueueStats {
+    size_t draws = 0;
+    // GL draw calls issued for them, and how many of those were multi-draws (see RenderQueue::SetBatching)
+    size_t drawCalls = 0, multiDraws = 0;
+    size_t programChanges = 0, materialChanges = 0, vaoChanges = 0, objectChanges = 0;
+    // draws the GPU may skip on an occlusion query result
+    size_t conditionalDraws = 0;
+    // what submitting the packets in the order they were added would have cost; only counted with stats enabled
+    size_t unsortedProgramChanges = 0, unsortedMaterialChanges = 0, unsortedVaoChanges = 0;
+};
+
+// 64-bit sort key of a packet. Opaque draws (top bit clear) are grouped by program, then material, then VAO, and
+// front to back inside a group for early depth rejection; translucent draws (top bit set) come last, back to front.
+//   opaque:      0 | program:12 | material:14 | vao:13 | depth:24
+//   translucent: 1 | ~depth:24  | program:12 | material:14 | vao:13
+// program, material and VAO are small per-frame ids (the order of first use), masked to their width: past 4096
+// programs (etc.) in one frame ids alias, which only costs sorting quality.
+namespace render_key
+{
+    const int PROGRAM_BITS = 12, MATERIAL_BITS = 14, VAO_BITS = 13, DEPTH_BITS = 24;
+
+    // positive floats order like their bit patterns; the top 24 bits (sign excluded) keep that order
+    inline uint64_t depthBits(float depth)
+    {
+        if (!(depth > 0.0f))
+            return 0;
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> (31 - DEPTH_BITS);
+    }
+
+    inline uint64_t field(uint32_t value, int bits)
+    {
+        return value & ((1u << bits) - 1);
+    }
+
+    inline uint64_t Make(bool translucent, uint32_t program, uint32_t material, uint32_t vao, float depth)
+    {
+        uint64_t state = field(program, PROGRAM_BITS) << (MATERIAL_BITS + VAO_BITS) | field(material, MATERIAL_BITS) << VAO_BITS |
+                         field(vao, VAO_BITS);
+        uint64_t depthKey = depthBits(depth);
+        if (!translucent)
+            return state << DEPTH_BITS | depthKey;
+        uint64_t backToFront = ((1u << DEPTH_BITS) - 1) - depthKey;
+        return 1ull << 63 | backToFront << (PROGRAM_BITS + MATERIAL_BITS + VAO_BITS) | state;
+    }
+
+    inline bool Translucent(uint64_t key)
+    {
+        return (key >> 63) != 0;
+    }
+}
+
+// the layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+struct SortItem {
+    uint64_t key;
+    uint32_t index;
+};
+
+// LSD radix sort on the key, 8 bits per pass; passes in which every key has the same byte are skipped, so keys that
+// only use a few bytes (or a queue with few distinct states) take fewer passes. Stable.
+inline void RadixSortByKey(std::vector<SortItem> &items, std::vector<SortItem> &scratch)
+{
+    if (items.size() < 2)
+        return;
+    scratch.resize(items.size());
+    SortItem *from = items.data(), *to = scratch.data();
+    size_t counts[8][256];
+    std::memset(counts, 0, sizeof(counts));
+    for (const SortItem &item : items)
+        for (int pass = 0; pass < 8; pass++)
+            counts[pass][(item.key >> (pass * 8)) & 0xFF]++;
+
+    for (int pass = 0; pass < 8; pass++)
+    {
+        size_t *count = counts[pass];
+        if (count[(items[0].key >> (pass * 8)) & 0xFF] == items.size())
+            continue;
+        size_t offsets[256];
+        size_t sum = 0;
+        for (int digit = 0; digit < 256; digit++)
+        {
+            offsets[digit] = sum;
+            sum += count[digit];
+        }
+        for (size_t i = 0; i < items.size(); i++)
+            to[offsets[(from[i].key >> (pass * 8)) & 0xFF]++] = from[i];
+        std::swap(from, to);
+    }
+    if (from != items.data())
+        std::memcpy(items.data(), from, items.size() * sizeof(SortItem));
+}
+
+// Collects a frame's draws, sorts them by state (see render_key) and submits them switching program, material,
+// VAO and per-object data only where consecutive draws differ.
+// With batching, every run of sorted draws that share program, material and VAO (meshes in a GeometryArena) goes
+// out as one multi-draw:
+//  - with ARB_multi_draw_indirect + ARB_base_instance: one glMultiDrawElementsIndirect per run, from a command
+//    buffer written once per frame. Command i has baseInstance i, so the instance attributes fetch the draw's own
+//    transform (object matrix with the mesh's dequantization folded in) from the InstanceBuffer: the draw ID lookup.
+//    The run is drawn with the INSTANCED variant of its program.
+//  - otherwise (plain 3.3): glMultiDrawElementsBaseVertex. Without a draw ID every draw of the call sees the same
+//    uniforms, so runs are split further where the object or the packed dequantization changes.
+class RenderQueue
+{
+public:
+    ~RenderQueue()
+    {
+        if (indirectBuffer)
+            GLState::Instance().DeleteBuffer(indirectBuffer);
+    }
+
+    // merges compatible consecutive draws into multi-draws
+    void SetBatching(bool enabled)
+    {
+        batching = enabled;
+    }
+
+    // per-object data for the packets that follow; returns the index for DrawPacket::object
+    uint32_t AddObject(const glm::mat4 &model)
+    {
+        ObjectData object{};
+        object.model = model;
+        objects.push_back(object);
+        return (uint32_t) objects.size() - 1;
+    }
+
+    void Add(const DrawPacket &packet)
+    {
+        packets.push_back(packet);
+    }
+
+    // counts what the unsorted order would have cost too (one extra pass over the packets)
+    void SetStatsEnabled(bool enabled)
+    {
+        statsEnabled = enabled;
+    }
+
+    // sorts and draws everything added since the last Submit, then empties the queue. Per-object data goes through
+    // objectUniforms, which must be bound to OBJECT_DATA_BINDING.
+    void Submit(UniformBuffer<ObjectData> &objectUniforms)
+    {
+        stats = RenderQueueStats();
+        stats.draws = packets.size();
+        if (statsEnabled)
+            countUnsortedChanges();
+        if (!packets.empty())
+        {
+            buildKeys();
+            RadixSortByKey(items, scratch);
+            draw(objectUniforms);
+        }
+        packets.clear();
+        objects.clear();
+    }
+
+    const RenderQueueStats &Stats() const { return stats; }
+
+private:
+    std::vector<DrawPacket> packets;
+    std::vector<ObjectData> objects;
+    std::vector<SortItem> items, scratch;
+    // per-frame dense ids, so the key fields stay narrow
+    std::unordered_map<const void*, uint32_t> programIds, materialIds;
+    std::unordered_map<unsigned int, uint32_t> vaoIds;
+    bool statsEnabled = false;
+    bool batching = false;
+    RenderQueueStats stats;
+
+    // sorted draws [begin, end) that go out as one GL call
+    enum class RunKind { Single, MultiDraw, Indirect };
+    struct Run {
+        RunKind kind;
+        size_t begin, end;
+        Shader *shader;
+        // into the per-kind arrays below
+        size_t first;
+    };
+    std::vector<Run> runs;
+    // Indirect runs
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<InstanceTransform> drawTransforms;
+    unsigned int indirectBuffer = 0;
+    // the dequantization uniforms Indirect runs reset, resolved for the program they were last used with (runs are
+    // sorted by program, so this only changes with it)
+    struct IndirectBindings {
+        unsigned int program = 0;
+        UniformHandle positionOffset, positionScale;
+    };
+    IndirectBindings indirectBindings;
+    // MultiDraw runs
+    std::vector<GLsizei> multiCounts;
+    std::vector<const void*> multiOffsets;
+    std::vector<GLint> multiBaseVertices;
+
+    const IndirectBindings &indirectBindingsFor(const Shader &shader)
+    {
+        if (indirectBindings.program == shader.ID)
+            return indirectBindings;
+        indirectBindings.program = shader.ID;
+        indirectBindings.positionOffset = shader.uniform("positionOffset");
+        indirectBindings.positionScale = shader.uniform("positionScale");
+        return indirectBindings;
+    }
+
+    template<typename Key>
+    static uint32_t idOf(std::unordered_map<Key, uint32_t> &ids, Key key)
+    {
+        return ids.emplace(key, (uint32_t) ids.size()).first->second;
+    }
+
+    void buildKeys()
+    {
+        programIds.clear();
+        materialIds.clear();
+        vaoIds.clear();
+        items.resize(packets.size());
+        for (size_t i = 0; i < packets.size(); i++)
+        {
+            const DrawPacket &packet = packets[i];
+            const Material *material = packet.mesh->material.get();
+            uint32_t program = idOf<const void*>(programIds, packet.shader);
+            uint32_t materialId = idOf<const void*>(materialIds, material);
+            uint32_t vao = idOf<unsigned int>(vaoIds, packet.mesh->VAO);
+            items[i].key = render_key::Make(material->Translucent(), program, materialId, vao, packet.depth);
+            items[i].index = (uint32_t) i;
+        }
+    }
+
+    // same program, material and VAO: can share a multi-draw
+    static bool sameState(const DrawPacket &a, const DrawPacket &b)
+    {
+        return a.shader == b.shader && a.variants == b.variants && a.mesh->material == b.mesh->material &&
+               a.mesh->VAO == b.mesh->VAO && !a.conditionQuery && !b.conditionQuery;
+    }
+
+    // same uniforms too: can share a multi-draw without a draw ID
+    static bool sameDrawData(const DrawPacket &a, const DrawPacket &b)
+    {
+        if (a.object != b.object)
+            return false;
+        if (a.mesh->layout != VertexLayout::Packed)
+            return true;
+        return a.mesh->positionQuantization.offset == b.mesh->positionQuantization.offset &&
+               a.mesh->positionQuantization.scale == b.mesh->positionQuantization.scale;
+    }
+
+    const DrawPacket &packetAt(size_t sorted) const
+    {
+        return packets[items[sorted].index];
+    }
+
+    void addRun(RunKind kind, size_t begin, size_t end, Shader *shader, size_t first)
+    {
+        Run run;
+        run.kind = kind;
+        run.begin = begin;
+        run.end = end;
+        run.shader = shader;
+        run.first = first;
+        runs.push_back(run);
+    }
+
+    // splits the sorted draws into runs and fills the multi-draw arrays
+    void planRuns()
+    {
+        runs.clear();
+        commands.clear();
+        drawTransforms.clear();
+        multiCounts.clear();
+        multiOffsets.clear();
+        multiBaseVertices.clear();
+        bool indirect = GLExtensions::Functions().MultiDrawElementsIndirect != nullptr;
+        size_t begin = 0;
+        while (begin < items.size())
+        {
+            const DrawPacket &first = packetAt(begin);
+            size_t end = begin + 1;
+            if (batching)
+                while (end < items.size() && sameState(first, packetAt(end)))
+                    end++;
+
+            Shader *instanced = nullptr;
+            if (end - begin > 1 && indirect && first.variants)
+                instanced = first.variants->Find(first.mesh->ShaderFeatures() | SHADER_INSTANCED);
+            if (instanced)
+            {
+                addRun(RunKind::Indirect, begin, end, instanced, commands.size());
+                for (size_t i = begin; i < end; i++)
+                {
+                    const DrawPacket &packet = packetAt(i);
+                    const Mesh &mesh = *packet.mesh;
+                    DrawElementsIndirectCommand command;
+                    command.count = (GLuint) mesh.IndexCount(packet.lod);
+                    command.instanceCount = 1;
+                    command.firstIndex = (GLuint) (mesh.IndexOffset(packet.lod) / (mesh.indexType == GL_UNSIGNED_SHORT ? 2 : 4));
+                    command.baseVertex = mesh.BaseVertex();
+                    command.baseInstance = (GLuint) drawTransforms.size();
+                    commands.push_back(command);
+                    drawTransforms.push_back(MakeInstanceTransform(objects[packet.object].model * mesh.PositionTransform()));
+                }
+                begin = end;
+                continue;
+            }
+
+            // no draw ID: only draws with the same uniforms can share a call
+            for (size_t from = begin; from < end;)
+            {
+                size_t to = from + 1;
+                while (to < end && sameDrawData(packetAt(from), packetAt(to)))
+                    to++;
+                if (to - from == 1)
+                {
+                    addRun(RunKind::Single, from, to, packetAt(from).shader, 0);
+                }
+                else
+                {
+                    addRun(RunKind::MultiDraw, from, to, packetAt(from).shader, multiCounts.size());
+                    for (size_t i = from; i < to; i++)
+                    {
+                        const DrawPacket &packet = packetAt(i);
+                        const Mesh &mesh = *packet.mesh;
+                        multiCounts.push_back(mesh.IndexCount(packet.lod));
+                        multiOffsets.push_back((const void*) mesh.IndexOffset(packet.lod));
+                        multiBaseVertices.push_back(mesh.BaseVertex());
+                    }
+                }
+                from = to;
+            }
+            begin = end;
+        }
+    }
+
+    // one upload each for the frame's commands and their transforms
+    void uploadIndirectData()
+    {
+        if (commands.empty())
+            return;
+        if (!indirectBuffer)
+            glGenBuffers(1, &indirectBuffer);
+        GLState::Instance().BindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+        InstanceBuffer::Shared().Upload(drawTransforms);
+    }
+
+    void draw(UniformBuffer<ObjectData> &objectUniforms)
+    {
+        planRuns();
+        uploadIndirectData();
+        Shader *boundShader = nullptr;
+        const Material *boundMaterial = nullptr;
+        unsigned int boundVAO = 0;
+        uint32_t boundObject = UINT32_MAX;
+        bool blending = false;
+        for (const Run &run : runs)
+        {
+            const DrawPacket &packet = packetAt(run.begin);
+            Mesh &mesh = *packet.mesh;
+            if (render_key::Translucent(items[run.begin].key) && !blending)
+            {
+                // translucent draws are sorted last: switch to blending once for all of them
+                GLState::Instance().Enable(GL_BLEND);
+                GLState::Instance().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                GLState::Instance().DepthMask(false);
+                blending = true;
+            }
+            if (run.shader != boundShader)
+            {
+                if (packet.variants)
+                    packet.variants->Use(*run.shader);
+                else
+                    run.shader->use();
+                boundShader = run.shader;
+                stats.programChanges++;
+            }
+            if (mesh.material.get() != boundMaterial)
+            {
+                mesh.material->Bind();
+                boundMaterial = mesh.material.get();
+                stats.materialChanges++;
+            }
+            if (mesh.VAO != boundVAO)
+            {
+                GLState::Instance().BindVertexArray(mesh.VAO);
+                boundVAO = mesh.VAO;
+                stats.vaoChanges++;
+            }
+            if (run.kind != RunKind::Indirect && packet.object != boundObject)
+            {
+                objectUniforms.Update(objects[packet.object]);
+                boundObject = packet.object;
+                stats.objectChanges++;
+            }
+
+            stats.drawCalls++;
+            if (packet.conditionQuery)
+            {
+                // NO_WAIT: drawn anyway while the query's result is still on its way
+                glBeginConditionalRender(packet.conditionQuery, GL_QUERY_NO_WAIT);
+                stats.conditionalDraws++;
+            }
+            GLsizei count = (GLsizei) (run.end - run.begin);
+            switch (run.kind)
+            {
+            case RunKind::Single:
+                mesh.DrawElements(*run.shader, packet.lod);
+                break;
+            case RunKind::MultiDraw:
+                mesh.SetPositionDequantization(*run.shader);
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, &multiCounts[run.first], mesh.indexType,
+                                              &multiOffsets[run.first], count, &multiBaseVertices[run.first]);
+                stats.multiDraws++;
+                break;
+            case RunKind::Indirect:
+            {
+                // the dequantization is part of each draw's transform
+                const IndirectBindings &bindings = indirectBindingsFor(*run.shader);
+                run.shader->setVec3(bindings.positionOffset, glm::vec3(0.0f));
+                run.shader->setVec3(bindings.positionScale, glm::vec3(1.0f));
+                InstanceBuffer::EnableAttributes(true);
+                GLExtensions::Functions().MultiDrawElementsIndirect(GL_TRIANGLES, mesh.indexType,
+                    (const void*) (run.first * sizeof(DrawElementsIndirectCommand)), count, 0);
+                InstanceBuffer::EnableAttributes(false);
+                stats.multiDraws++;
+                break;
+            }
+            }
+            if (packet.conditionQuery)
+                glEndConditionalRender();
+        }
+        if (blending)
+        {
+            GLState::Instance().DepthMask(true);
+            GLState::Instance().Disable(GL_BLEND);
+        }
+    }
+
+    void countUnsortedChanges()
+    {
+        const Shader *shader = nullptr;
+        const Material *material = nullptr;
+        unsigned int vao = 0;
+        for (const DrawPacket &packet : packets)
+        {
+            stats.unsortedProgramChanges += packet.shader != shader;
+            stats.unsortedMaterialChanges += packet.mesh->material.get() != material;
+            stats.unsortedVaoChanges += packet.mesh->VAO != vao;
+            shader = packet.shader;
+            material = packet.mesh->material.get();
+            vao = packet.mesh->VAO;
+        }
+    }
+};
+#endif
@@ -0,0 +1,101 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/bounds.h>
+#include <learnopengl/bvh.h>
+#include <learnopengl/frustum.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Copies of one model placed in the world, with a BVH over their world boxes for culling and picking.
+class InstanceScene
+{
+public:
+    // bounds: the model's, in model space (Model::Bounds())
+    explicit InstanceScene(const MeshBounds &bounds = MeshBounds()) : modelBounds(bounds)
+    {
+    }
+
+    void SetModelBounds(const MeshBounds &bounds)
+    {
+        modelBounds = bounds;
+        dirty = true;
+    }
+
+    // places the instances: the BVH is rebuilt when their number changes and refit when only their transforms do.
+    // Returns false when nothing changed, true when an instance index may now stand for another placement (state kept
+    // per index elsewhere, like query results or LODs, is stale then).
+    bool SetTransforms(const std::vector<glm::mat4> &value)
+    {
+        bool rebuild = dirty || value.size() != transforms.size();
+        if (!rebuild && value == transforms)
+            return false;
+        transforms = value;
+        dirty = false;
+        if (modelBounds.Empty())
+        {
+            // nothing to build a BVH from: every instance counts as visible
+            bvh.Clear();
+            return true;
+        }
+        worldBoxes.resize(transforms.size());
+        for (size_t i = 0; i < transforms.size(); i++)
+            worldBoxes[i] = modelBounds.box.Transformed(transforms[i]);
+        if (rebuild)
+            bvh.Build(worldBoxes);
+        else
+            bvh.Refit(worldBoxes);
+        return true;
+    }
+
+    const std::vector<glm::mat4> &Transforms() const { return transforms; }
+    size_t Size() const { return transforms.size(); }
+
+    // the instances whose boxes are not entirely outside the frustum, in placement order (so the draw order doesn't
+    // jump around as the camera moves)
+    void Visible(const Frustum &frustum, std::vector<uint32_t> &instances)
+    {
+        if (bvh.Empty())
+        {
+            instances.resize(transforms.size());
+            for (uint32_t i = 0; i < instances.size(); i++)
+                instances[i] = i;
+            return;
+        }
+        bvh.QueryFrustum(frustum, instances);
+        std::sort(instances.begin(), instances.end());
+    }
+
+    // the same, as their transforms
+    void Visible(const Frustum &frustum, std::vector<glm::mat4> &result)
+    {
+        Visible(frustum, visible);
+        result.clear();
+        for (uint32_t instance : visible)
+            result.push_back(transforms[instance]);
+    }
+
+    // the instance whose box the ray hits first, or -1
+    int Pick(const Ray &ray, float *distance = nullptr) const
+    {
+        RayHit hit;
+        if (!bvh.Raycast(ray, hit))
+            return -1;
+        if (distance)
+            *distance = hit.distance;
+        return (int) hit.object;
+    }
+
+private:
+    MeshBounds modelBounds;
+    std::vector<glm::mat4> transforms;
+    std::vector<BoundingBox> worldBoxes;
+    std::vector<uint32_t> visible;
+    BVH bvh;
+    bool dirty = true;
+};
+#endif
@@ -9,6 +9,19 @@
 #include <sstream>
 #include <iostream>
 #include <common.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/material.h>
+#include <learnopengl/program_cache.h>
+#include <learnopengl/uniform_buffer.h>
+#include <learnopengl/uniform_table.h>
+
+// the code of every stage of a program; an empty geometry stage means there is none
+struct ShaderSource {
+    std::string vertex;
+    std::string fragment;
+    std::string geometry;
+};
+
 class Shader
 {
 public:
@@ -64,114 +77,277 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
+        build({vertexCode, fragmentCode, geometryCode}, false);
+    }
+    // generates the shader from code in memory (e.g. a base source with injected #defines)
+    // async: only submit the compile and link; the shader can't be used before Ready() returns true (or Wait())
+    // ------------------------------------------------------------------------
+    explicit Shader(const ShaderSource &source, bool async = false)
+    {
+        build(source, async);
+    }
+    // whether the program is linked and usable; never waits for the driver when it supports
+    // KHR_parallel_shader_compile. Without it there is no way to ask, so an async build is finished here.
+    // ------------------------------------------------------------------------
+    bool Ready()
+    {
+        if (pending.active)
         {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            GLint done = GL_TRUE;
+            if (GLExtensions::ParallelShaderCompile())
+                glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+            if (!done)
+                return false;
+            finish();
         }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        return linked;
+    }
+    // still compiling or linking in the driver
+    bool Pending() const
+    {
+        return pending.active;
+    }
+    // finishes an async build, waiting for the driver if necessary
+    void Wait()
+    {
+        if (pending.active)
+            finish();
     }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        GLState::Instance().UseProgram(ID);
+    }
+    // resolves a uniform name once; the handle is only valid for this shader
+    // ------------------------------------------------------------------------
+    UniformHandle uniform(const std::string &name) const
+    {
+        return uniforms.Handle(name);
     }
-    // utility uniform functions
+    // utility uniform functions (by name: a hash lookup per call, prefer handles in per-frame code)
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        setBool(uniforms.Handle(name), value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        setInt(uniforms.Handle(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        setFloat(uniforms.Handle(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec2(uniforms.Handle(name), value);
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        setVec2(uniforms.Handle(name), glm::vec2(x, y));
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec3(uniforms.Handle(name), value);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        setVec3(uniforms.Handle(name), glm::vec3(x, y, z));
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec4(uniforms.Handle(name), value);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        setVec4(uniforms.Handle(name), glm::vec4(x, y, z, w));
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat2(uniforms.Handle(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat3(uniforms.Handle(name), mat);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(uniforms.Handle(name), mat);
+    }
+
+    // utility uniform functions taking handles: no name lookup at all. A value equal to the one last set through
+    // this shader is not sent again (uniforms are program state); don't mix with raw glUniform* calls on ID.
+    // ------------------------------------------------------------------------
+    void setBool(UniformHandle uniform, bool value) const
+    {
+        setInt(uniform, (int)value);
+    }
+    void setInt(UniformHandle uniform, int value) const
+    {
+        if (uniforms.Changed(uniform.location, &value, sizeof(int)))
+            glUniform1i(uniform.location, value);
+    }
+    void setFloat(UniformHandle uniform, float value) const
+    {
+        if (uniforms.Changed(uniform.location, &value, sizeof(float)))
+            glUniform1f(uniform.location, value);
+    }
+    void setVec2(UniformHandle uniform, const glm::vec2 &value) const
+    {
+        if (uniforms.Changed(uniform.location, &value[0], 2 * sizeof(float)))
+            glUniform2fv(uniform.location, 1, &value[0]);
+    }
+    void setVec3(UniformHandle uniform, const glm::vec3 &value) const
+    {
+        if (uniforms.Changed(uniform.location, &value[0], 3 * sizeof(float)))
+            glUniform3fv(uniform.location, 1, &value[0]);
+    }
+    void setVec4(UniformHandle uniform, const glm::vec4 &value) const
+    {
+        if (uniforms.Changed(uniform.location, &value[0], 4 * sizeof(float)))
+            glUniform4fv(uniform.location, 1, &value[0]);
+    }
+    void setMat2(UniformHandle uniform, const glm::mat2 &mat) const
+    {
+        if (uniforms.Changed(uniform.location, &mat[0][0], 4 * sizeof(float)))
+            glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat3(UniformHandle uniform, const glm::mat3 &mat) const
+    {
+        if (uniforms.Changed(uniform.location, &mat[0][0], 9 * sizeof(float)))
+            glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(UniformHandle uniform, const glm::mat4 &mat) const
+    {
+        if (uniforms.Changed(uniform.location, &mat[0][0], 16 * sizeof(float)))
+            glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+
+    // how many uniform sets were skipped (hits) and sent (misses) since the last reset
+    UniformUploadStats uniformStats() const
+    {
+        return uniforms.Stats();
+    }
+    void resetUniformStats()
+    {
+        uniforms.ResetStats();
     }
 
 private:
+    // active uniforms of the program, reflected after linking
+    UniformTable uniforms;
+
+    // the stages of a submitted build whose results haven't been read back yet
+    struct PendingBuild {
+        bool active = false;
+        unsigned int vertex = 0, fragment = 0, geometry = 0;
+        uint64_t binaryKey = 0;
+    };
+    PendingBuild pending;
+    bool linked = false;
+
+    void build(const ShaderSource &source, bool async)
+    {
+        // a binary of the same sources from an earlier run (same driver) skips compiling and linking entirely
+        uint64_t binaryKey = ProgramBinaryCache::Key({source.vertex, source.fragment, source.geometry});
+        ID = ProgramBinaryCache::Load(binaryKey);
+        if (ID != 0)
+        {
+            linked = true;
+            reflect();
+            return;
+        }
+        submit(source);
+        pending.binaryKey = binaryKey;
+        if (!async)
+            finish();
+    }
+
+    // compiles the stages and links them into a new program without asking for any status, so a driver with
+    // parallel compilation can work on it in the background
+    // ------------------------------------------------------------------------
+    void submit(const ShaderSource &source)
+    {
+        bool hasGeometry = !source.geometry.empty();
+        const char* vShaderCode = source.vertex.c_str();
+        const char * fShaderCode = source.fragment.c_str();
+        // compile shaders
+        unsigned int vertex, fragment;
+        // vertex shader
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        // fragment Shader
+        fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(fragment, 1, &fShaderCode, NULL);
+        glCompileShader(fragment);
+        // if geometry shader is given, compile geometry shader
+        unsigned int geometry = 0;
+        if(hasGeometry)
+        {
+            const char * gShaderCode = source.geometry.c_str();
+            geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(geometry, 1, &gShaderCode, NULL);
+            glCompileShader(geometry);
+        }
+        // shader Program
+        ID = glCreateProgram();
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        if(hasGeometry)
+            glAttachShader(ID, geometry);
+        ProgramBinaryCache::MarkRetrievable(ID);
+        glLinkProgram(ID);
+
+        pending.active = true;
+        pending.vertex = vertex;
+        pending.fragment = fragment;
+        pending.geometry = geometry;
+    }
+
+    // reads back the results of a submitted build (this waits if the driver isn't done yet); errors are printed
+    void finish()
+    {
+        checkCompileErrors(pending.vertex, "VERTEX");
+        checkCompileErrors(pending.fragment, "FRAGMENT");
+        if (pending.geometry)
+            checkCompileErrors(pending.geometry, "GEOMETRY");
+        checkCompileErrors(ID, "PROGRAM");
+        // delete the shaders as they're linked into our program now and no longer necessery
+        glDeleteShader(pending.vertex);
+        glDeleteShader(pending.fragment);
+        if (pending.geometry)
+            glDeleteShader(pending.geometry);
+        pending.active = false;
+
+        GLint status = GL_FALSE;
+        glGetProgramiv(ID, GL_LINK_STATUS, &status);
+        linked = status == GL_TRUE;
+        if (linked)
+            ProgramBinaryCache::Store(ID, pending.binaryKey);
+        reflect();
+    }
+
+    void reflect()
+    {
+        uniforms.Reflect(ID);
+        BindSharedUniformBlocks(ID);
+        BindMaterialSamplers(ID);
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    static void checkCompileErrors(GLuint shader, std::string type)
     {
         GLint success;
         GLchar infoLog[1024];
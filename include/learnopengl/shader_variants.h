@@ -0,0 +1,222 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <common.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Optional features of the model lighting shaders; a variant is compiled for every combination actually drawn.
+// Bit i switches on the #define SHADER_FEATURE_DEFINES[i].
+enum ShaderFeature : uint32_t {
+    SHADER_PACKED_VERTICES = 1u << 0,
+    SHADER_DIFFUSE_MAP = 1u << 1,
+    SHADER_SPECULAR_MAP = 1u << 2,
+    SHADER_NORMAL_MAP = 1u << 3,
+    // model matrix from the per-instance attributes (learnopengl/instance_buffer.h) instead of ObjectData
+    SHADER_INSTANCED = 1u << 4
+};
+
+const std::vector<std::string> SHADER_FEATURE_DEFINES = {"PACKED_VERTICES", "HAS_DIFFUSE_MAP", "HAS_SPECULAR_MAP", "HAS_NORMAL_MAP", "INSTANCED"};
+
+// inserts the defines right after the #version line (which has to stay the first statement)
+inline std::string InjectDefines(const std::string &source, const std::vector<std::string> &defines)
+{
+    if (defines.empty())
+        return source;
+    std::string block;
+    for (const std::string &define : defines)
+        block += "#define " + define + "\n";
+    size_t version = source.find("#version");
+    size_t insertAt = version == std::string::npos ? 0 : source.find('\n', version);
+    if (insertAt == std::string::npos)
+        return source + "\n" + block;
+    if (version != std::string::npos)
+        insertAt++;
+    // keep the line numbers of compile errors pointing at the original file
+    size_t nextLine = std::count(source.begin(), source.begin() + insertAt, '\n') + 1;
+    return source.substr(0, insertAt) + block + "#line " + std::to_string(nextLine) + "\n" + source.substr(insertAt);
+}
+
+// One base vertex/fragment source pair, compiled on demand into one program per feature mask.
+// Variants are compiled the first time they are asked for (or ahead of time with Prepare) and kept for the
+// lifetime of the set; with the program binary cache, later runs load them instead of compiling.
+// Prepare only submits the work: with KHR_parallel_shader_compile the driver compiles on its own threads while the
+// application goes on loading, and Find hands out a simpler variant that is ready until the requested one is.
+class ShaderVariants
+{
+public:
+    // defines: always injected (e.g. "MAX_LIGHTS 8"); featureDefines: the #define of each feature bit;
+    // inputFeatures: bits that change the vertex inputs, which a fallback variant has to match exactly
+    ShaderVariants(const std::string &vertexPath, const std::string &fragmentPath, std::vector<std::string> defines = {},
+                   std::vector<std::string> featureDefines = SHADER_FEATURE_DEFINES, uint32_t inputFeatures = SHADER_PACKED_VERTICES | SHADER_INSTANCED)
+        : defines(std::move(defines)), featureDefines(std::move(featureDefines)), inputFeatures(inputFeatures)
+    {
+        base.vertex = readFileContents(vertexPath);
+        base.fragment = readFileContents(fragmentPath);
+        if (base.vertex.empty() || base.fragment.empty())
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << vertexPath << ", " << fragmentPath << std::endl;
+    }
+
+    // the variant with exactly these features, compiled (and waited for) if it isn't ready yet
+    Shader &Get(uint32_t features)
+    {
+        Shader &variant = submit(features);
+        variant.Wait();
+        return variant;
+    }
+
+    // starts compiling a variant ahead of its first use, e.g. during loading; doesn't wait for it
+    void Prepare(uint32_t features)
+    {
+        submit(features);
+    }
+
+    // the requested variant if it's ready, else the ready variant with the most of the requested features (and the
+    // same vertex inputs), else nullptr; never waits. Starts compiling the requested variant if nobody has yet.
+    Shader *Find(uint32_t features)
+    {
+        Shader &requested = submit(features);
+        if (requested.Ready())
+            return &requested;
+        Shader *best = nullptr;
+        int bestCount = -1;
+        for (auto &variant : variants)
+        {
+            uint32_t mask = variant.first;
+            if (mask == features || (mask & ~features) != 0 || (mask & inputFeatures) != (features & inputFeatures))
+                continue;
+            int count = bitCount(mask);
+            if (count > bestCount && variant.second->Ready())
+            {
+                best = variant.second.get();
+                bestCount = count;
+            }
+        }
+        return best;
+    }
+
+    // finishes the variants the driver is done with (see Shader::Ready); returns how many are still compiling
+    size_t Poll()
+    {
+        size_t count = 0;
+        for (auto &variant : variants)
+        {
+            variant.second->Ready();
+            count += variant.second->Pending() ? 1 : 0;
+        }
+        return count;
+    }
+
+    // makes the variant current and applies the uniforms set on the whole set
+    void Use(Shader &shader)
+    {
+        shader.use();
+        for (const CommonUniform &uniform : common)
+        {
+            if (uniform.isInt)
+                shader.setInt(uniform.name, uniform.intValue);
+            else if (uniform.components == 1)
+                shader.setFloat(uniform.name, uniform.value.x);
+            else
+                shader.setVec3(uniform.name, uniform.value);
+        }
+    }
+
+    // plain uniforms every variant gets on Use; unchanged values cost no GL call (see UniformTable)
+    void SetInt(const std::string &name, int value) { commonUniform(name).isInt = true; commonUniform(name).intValue = value; }
+    void SetFloat(const std::string &name, float value) { setCommon(name, glm::vec3(value, 0.0f, 0.0f), 1); }
+    void SetVec3(const std::string &name, const glm::vec3 &value) { setCommon(name, value, 3); }
+
+    size_t Size() const { return variants.size(); }
+
+    UniformUploadStats UniformStats() const
+    {
+        UniformUploadStats total;
+        for (const auto &variant : variants)
+        {
+            UniformUploadStats stats = variant.second->uniformStats();
+            total.hits += stats.hits;
+            total.misses += stats.misses;
+        }
+        return total;
+    }
+
+    void ResetUniformStats()
+    {
+        for (auto &variant : variants)
+            variant.second->resetUniformStats();
+    }
+
+private:
+    struct CommonUniform {
+        std::string name;
+        bool isInt = false;
+        int intValue = 0;
+        int components = 1;
+        glm::vec3 value = glm::vec3(0.0f);
+    };
+
+    ShaderSource base;
+    std::vector<std::string> defines;
+    std::vector<std::string> featureDefines;
+    uint32_t inputFeatures;
+    std::unordered_map<uint32_t, std::unique_ptr<Shader>> variants;
+    std::vector<CommonUniform> common;
+
+    Shader &submit(uint32_t features)
+    {
+        std::unique_ptr<Shader> &variant = variants[features];
+        if (!variant)
+            variant.reset(new Shader(sourceFor(features), true));
+        return *variant;
+    }
+
+    static int bitCount(uint32_t mask)
+    {
+        int count = 0;
+        for (; mask; mask &= mask - 1)
+            count++;
+        return count;
+    }
+
+    ShaderSource sourceFor(uint32_t features) const
+    {
+        std::vector<std::string> active = defines;
+        for (size_t bit = 0; bit < featureDefines.size(); bit++)
+            if (features & (1u << bit))
+                active.push_back(featureDefines[bit]);
+        ShaderSource source;
+        source.vertex = InjectDefines(base.vertex, active);
+        source.fragment = InjectDefines(base.fragment, active);
+        return source;
+    }
+
+    CommonUniform &commonUniform(const std::string &name)
+    {
+        for (CommonUniform &uniform : common)
+            if (uniform.name == name)
+                return uniform;
+        common.push_back(CommonUniform());
+        common.back().name = name;
+        return common.back();
+    }
+
+    void setCommon(const std::string &name, const glm::vec3 &value, int components)
+    {
+        CommonUniform &uniform = commonUniform(name);
+        uniform.isInt = false;
+        uniform.components = components;
+        uniform.value = value;
+    }
+};
+#endif
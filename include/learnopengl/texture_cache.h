@@ -0,0 +1,155 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/texture_loader.h>
+#include <common.h>
+
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+// Process-wide registry of loaded textures, so every model and material that uses an image shares one GPU texture.
+//
+// Textures are found by canonical path (symlinks and "../" resolved) and, if ShareByContent is on, also by a hash of
+// the file's bytes, which catches the same image shipped under different names. Every Acquire() takes a reference
+// that has to be given back with Release(); the texture is deleted when the last reference goes away.
+class TextureCache
+{
+public:
+    // additionally dedupe textures with identical file contents (costs reading every new file once on the calling thread)
+    bool ShareByContent = false;
+
+    static TextureCache &Instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    // returns the texture for the image at path, loading it as the options say if nobody holds it yet
+    unsigned int Acquire(const std::string &path, const TextureLoadOptions &options = TextureLoadOptions())
+    {
+        // textures loaded differently are different textures; whether they arrive asynchronously doesn't matter
+        std::string variant = std::string(options.gamma ? "#gamma" : "") + (options.Baked() ? "#baked" : "")
+                + (options.compress ? options.normalMap ? "#bc-normal" : "#bc" : "") + (options.Baked() && options.srgb ? "#srgb" : "");
+        std::string key = canonicalPath(path) + variant;
+        auto found = byPath.find(key);
+        if (found != byPath.end())
+            return addReference(found->second);
+
+        uint64_t contentHash = 0;
+        if (ShareByContent && hashFile(path, contentHash))
+        {
+            contentHash = hashString(variant, contentHash);
+            auto sameContent = byContent.find(contentHash);
+            if (sameContent != byContent.end())
+            {
+                byPath[key] = sameContent->second;
+                return addReference(sameContent->second);
+            }
+        }
+
+        unsigned int textureID = load(path, options);
+
+        Entry &entry = entries[textureID];
+        entry.references = 1;
+        entry.contentHash = contentHash;
+        byPath[key] = textureID;
+        if (contentHash != 0)
+            byContent[contentHash] = textureID;
+        return textureID;
+    }
+
+    // gives back one reference taken by Acquire; the texture is deleted once nobody references it anymore
+    void Release(unsigned int textureID)
+    {
+        auto found = entries.find(textureID);
+        if (found == entries.end())
+        {
+            std::cout << "ERROR::TEXTURE_CACHE:: releasing texture " << textureID << " that is not in the cache" << std::endl;
+            return;
+        }
+        if (--found->second.references > 0)
+            return;
+
+        for (auto it = byPath.begin(); it != byPath.end(); )
+            it = it->second == textureID ? byPath.erase(it) : std::next(it);
+        if (found->second.contentHash != 0)
+            byContent.erase(found->second.contentHash);
+        entries.erase(found);
+
+        AsyncTextureLoader::Instance().Cancel(textureID);
+        GLState::Instance().DeleteTexture(textureID);
+    }
+
+    unsigned int References(unsigned int textureID) const
+    {
+        auto found = entries.find(textureID);
+        return found == entries.end() ? 0 : found->second.references;
+    }
+
+    // number of distinct GPU textures held
+    unsigned int Size() const
+    {
+        return entries.size();
+    }
+
+private:
+    struct Entry {
+        unsigned int references = 0;
+        uint64_t contentHash = 0;
+    };
+
+    std::unordered_map<std::string, unsigned int> byPath;
+    std::unordered_map<uint64_t, unsigned int> byContent;
+    std::unordered_map<unsigned int, Entry> entries;
+
+    TextureCache() = default;
+
+    static unsigned int load(const std::string &path, const TextureLoadOptions &options)
+    {
+        if (options.async)
+            return AsyncTextureLoader::Instance().Load(path, options);
+        if (options.Baked())
+            return BakedTextureFromFile(path, BakeSettingsFor(options));
+        std::string::size_type slash = path.find_last_of('/');
+        if (slash == std::string::npos)
+            return TextureFromFile(path.c_str(), ".", options.gamma);
+        return TextureFromFile(path.c_str() + slash + 1, path.substr(0, slash), options.gamma);
+    }
+
+    unsigned int addReference(unsigned int textureID)
+    {
+        entries[textureID].references++;
+        return textureID;
+    }
+
+    static std::string canonicalPath(const std::string &path)
+    {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved))
+            return resolved;
+        // missing file: it will fail to load anyway, key it by the name it was asked for
+        return path;
+    }
+
+    static bool hashFile(const std::string &path, uint64_t &hash)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        hash = hashBytes(nullptr, 0);
+        char buffer[1 << 16];
+        while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0)
+            hash = hashBytes(buffer, in.gcount(), hash);
+        return true;
+    }
+};
+#endif
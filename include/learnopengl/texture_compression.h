@@ -0,0 +1,283 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <learnopengl/image.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// CPU encoders for the BCn block compressed formats. Pure functions of the pixel data (no OpenGL), so they can run on
+// any thread. Every format encodes 4x4 texel blocks into 8 (BC1, BC4) or 16 (BC3, BC5) bytes, i.e. 4 or 8 bits per texel.
+//   BC1: RGB, two RGB565 endpoints + 2-bit indices
+//   BC3: RGBA, BC4-style alpha block followed by a BC1 color block
+//   BC4: one channel, two 8-bit endpoints + 3-bit indices
+//   BC5: two channels, two BC4 blocks (red, then green) - used for normal maps
+enum class BlockFormat {
+    BC1,
+    BC3,
+    BC4,
+    BC5
+};
+
+inline size_t BlockBytes(BlockFormat format)
+{
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+inline size_t CompressedSize(BlockFormat format, int width, int height)
+{
+    return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(format);
+}
+
+namespace bc {
+
+inline uint16_t packRGB565(const float color[3])
+{
+    int r = (int) std::lround(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f);
+    int g = (int) std::lround(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f);
+    int b = (int) std::lround(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f);
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+inline void unpackRGB565(uint16_t packed, int color[3])
+{
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+// picks the closest of the 4 palette entries of c0 > c1 for every texel; returns the packed indices and the total error
+inline uint32_t bc1Indices(const unsigned char *rgba, uint16_t c0, uint16_t c1, int &error)
+{
+    int palette[4][3];
+    unpackRGB565(c0, palette[0]);
+    unpackRGB565(c1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    uint32_t indices = 0;
+    error = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        int best = 0, bestDistance = 1 << 30;
+        for (int p = 0; p < 4; p++)
+        {
+            int dr = rgba[4 * i] - palette[p][0], dg = rgba[4 * i + 1] - palette[p][1], db = rgba[4 * i + 2] - palette[p][2];
+            int distance = dr * dr + dg * dg + db * db;
+            if (distance < bestDistance)
+            {
+                bestDistance = distance;
+                best = p;
+            }
+        }
+        indices |= (uint32_t) best << (2 * i);
+        error += bestDistance;
+    }
+    return indices;
+}
+
+// endpoints in 4-color mode (c0 > c1); equal endpoints mean a solid block where every index is 0
+inline void orderBC1Endpoints(uint16_t &c0, uint16_t &c1)
+{
+    if (c0 < c1)
+        std::swap(c0, c1);
+}
+
+inline void writeBC1(unsigned char *out, uint16_t c0, uint16_t c1, uint32_t indices)
+{
+    out[0] = c0 & 0xff;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xff;
+    out[3] = c1 >> 8;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+} // namespace bc
+
+// rgba: 16 texels, row by row, 4 bytes each (alpha ignored)
+inline void EncodeBC1Block(const unsigned char *rgba, unsigned char *out)
+{
+    // fit a line through the block's colors: mean + principal axis of their covariance
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += rgba[4 * i + c] / 16.0f;
+    float cov[6] = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 16; i++)
+    {
+        float d[3] = {rgba[4 * i] - mean[0], rgba[4 * i + 1] - mean[1], rgba[4 * i + 2] - mean[2]};
+        cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+    }
+    float axis[3] = {1, 1, 1};
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[3] = {
+                cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+                cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+                cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]};
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float minT = 1e30f, maxT = -1e30f;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = (rgba[4 * i] - mean[0]) * axis[0] + (rgba[4 * i + 1] - mean[1]) * axis[1] + (rgba[4 * i + 2] - mean[2]) * axis[2];
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    // pull the endpoints in a little: the extremes are rarely hit exactly and the interpolated entries get more use
+    float inset = (maxT - minT) / 16.0f;
+    float high[3], low[3];
+    for (int c = 0; c < 3; c++)
+    {
+        high[c] = mean[c] + axis[c] * (maxT - inset);
+        low[c] = mean[c] + axis[c] * (minT + inset);
+    }
+    uint16_t c0 = bc::packRGB565(high), c1 = bc::packRGB565(low);
+    bc::orderBC1Endpoints(c0, c1);
+    int error;
+    uint32_t indices = c0 == c1 ? 0 : bc::bc1Indices(rgba, c0, c1, error);
+
+    // one least squares pass: the endpoints that best reproduce the block with the chosen indices
+    if (c0 != c1)
+    {
+        static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+        float aa = 0, bb = 0, ab = 0, ax[3] = {0, 0, 0}, bx[3] = {0, 0, 0};
+        for (int i = 0; i < 16; i++)
+        {
+            float a = weights[(indices >> (2 * i)) & 3], b = 1.0f - a;
+            aa += a * a;
+            bb += b * b;
+            ab += a * b;
+            for (int c = 0; c < 3; c++)
+            {
+                ax[c] += a * rgba[4 * i + c];
+                bx[c] += b * rgba[4 * i + c];
+            }
+        }
+        float determinant = aa * bb - ab * ab;
+        if (std::fabs(determinant) > 1e-6f)
+        {
+            float refinedHigh[3], refinedLow[3];
+            for (int c = 0; c < 3; c++)
+            {
+                refinedHigh[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+                refinedLow[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+            }
+            uint16_t r0 = bc::packRGB565(refinedHigh), r1 = bc::packRGB565(refinedLow);
+            bc::orderBC1Endpoints(r0, r1);
+            if (r0 != r1)
+            {
+                int refinedError;
+                uint32_t refinedIndices = bc::bc1Indices(rgba, r0, r1, refinedError);
+                if (refinedError < error)
+                {
+                    c0 = r0;
+                    c1 = r1;
+                    indices = refinedIndices;
+                }
+            }
+        }
+    }
+    bc::writeBC1(out, c0, c1, indices);
+}
+
+// values: 16 texels of a single channel, `stride` bytes apart
+inline void EncodeBC4Block(const unsigned char *values, int stride, unsigned char *out)
+{
+    int low = 255, high = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        low = std::min<int>(low, values[i * stride]);
+        high = std::max<int>(high, values[i * stride]);
+    }
+    // 8-value mode: index 0 = high, 1 = low, 2..7 interpolate between them
+    int palette[8] = {high, low};
+    for (int i = 2; i < 8; i++)
+        palette[i] = ((8 - i) * high + (i - 1) * low) / 7;
+
+    uint64_t indices = 0;
+    if (high != low)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0, bestDistance = 256;
+            for (int p = 0; p < 8; p++)
+            {
+                int distance = std::abs(values[i * stride] - palette[p]);
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = p;
+                }
+            }
+            indices |= (uint64_t) best << (3 * i);
+        }
+    }
+    out[0] = (unsigned char) high;
+    out[1] = (unsigned char) low;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+inline void EncodeBC3Block(const unsigned char *rgba, unsigned char *out)
+{
+    EncodeBC4Block(rgba + 3, 4, out);
+    EncodeBC1Block(rgba, out + 8);
+}
+
+// rgba: red and green hold the two channels (x and y of a normal)
+inline void EncodeBC5Block(const unsigned char *rgba, unsigned char *out)
+{
+    EncodeBC4Block(rgba, 4, out);
+    EncodeBC4Block(rgba + 1, 4, out + 8);
+}
+
+// compresses a whole image, one block row per ParallelFor task. Edge blocks of sizes that are not a multiple of 4 repeat
+// their last row/column. Channels are expanded as: 1 -> (v, v, v, 255), 2 -> (r, g, 0, 255), 3 -> (r, g, b, 255).
+inline std::vector<unsigned char> CompressImage(const Image &image, BlockFormat format, ThreadPool &pool = ThreadPool::Shared())
+{
+    int blocksX = (image.width + 3) / 4, blocksY = (image.height + 3) / 4;
+    size_t blockBytes = BlockBytes(format);
+    std::vector<unsigned char> result((size_t) blocksX * blocksY * blockBytes);
+    pool.ParallelFor(blocksY, [&](size_t blockY) {
+        unsigned char rgba[64];
+        for (int blockX = 0; blockX < blocksX; blockX++)
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                int x = std::min(blockX * 4 + i % 4, image.width - 1);
+                int y = std::min((int) blockY * 4 + i / 4, image.height - 1);
+                const unsigned char *texel = image.Pixel(x, y);
+                unsigned char *expanded = rgba + 4 * i;
+                expanded[0] = texel[0];
+                expanded[1] = image.channels == 1 ? texel[0] : texel[1];
+                expanded[2] = image.channels == 1 ? texel[0] : image.channels == 2 ? 0 : texel[2];
+                expanded[3] = image.channels == 4 ? texel[3] : 255;
+            }
+            unsigned char *out = &result[((size_t) blockY * blocksX + blockX) * blockBytes];
+            switch (format)
+            {
+                case BlockFormat::BC1: EncodeBC1Block(rgba, out); break;
+                case BlockFormat::BC3: EncodeBC3Block(rgba, out); break;
+                case BlockFormat::BC4: EncodeBC4Block(rgba, 4, out); break;
+                case BlockFormat::BC5: EncodeBC5Block(rgba, out); break;
+            }
+        }
+    });
+    return result;
+}
+#endif
@@ -0,0 +1,330 @@
+#ifndef TEXTURE_FILE_H
+#define TEXTURE_FILE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/gl_state.h>
+#include <learnopengl/image.h>
+#include <learnopengl/texture_compression.h>
+#include <common.h>
+
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// GPU-ready texture data: every mip level pre-filtered, in its final format and in OpenGL's bottom-row-first
+// orientation, as stored in the on-disk texture cache. Loading one is a sequential read and one upload per level:
+// no decode, no flip pass and no glGenerateMipmap.
+//
+// Cache file layout (a minimal KTX/DDS-like container, offsets from the start of the file, levels 16-byte aligned):
+//   TextureFileHeader
+//   TextureFileLevel[levelCount]   largest level first
+//   level data
+
+enum class TextureFormat : uint32_t {
+    R8 = 1,
+    RG8,
+    RGB8,
+    RGBA8,
+    BC1,
+    BC3,
+    BC4,
+    BC5
+};
+
+inline bool IsCompressed(TextureFormat format)
+{
+    return format >= TextureFormat::BC1;
+}
+
+inline GLenum GLInternalFormat(TextureFormat format)
+{
+    switch (format)
+    {
+        case TextureFormat::R8: return GL_R8;
+        case TextureFormat::RG8: return GL_RG8;
+        case TextureFormat::RGB8: return GL_RGB8;
+        case TextureFormat::RGBA8: return GL_RGBA8;
+        case TextureFormat::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TextureFormat::BC3: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case TextureFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+        case TextureFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+    }
+    return GL_RGBA8;
+}
+
+// pixel format of the uncompressed formats
+inline GLenum GLPixelFormat(TextureFormat format)
+{
+    switch (format)
+    {
+        case TextureFormat::R8: return GL_RED;
+        case TextureFormat::RG8: return GL_RG;
+        case TextureFormat::RGB8: return GL_RGB;
+        default: return GL_RGBA;
+    }
+}
+
+const char TEXTURE_FILE_MAGIC[8] = {'R', 'G', 'T', 'E', 'X', '\0', '\0', '\0'};
+// bump whenever the layout or the way levels are produced changes
+const uint32_t TEXTURE_FILE_VERSION = 2;
+
+struct TextureFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    uint32_t reserved;
+    int64_t sourceMtime;
+    int64_t sourceMtimeNsec;
+    uint64_t sourceSize;
+    uint64_t key;
+};
+
+struct TextureFileLevel {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct TextureData {
+    TextureFormat format = TextureFormat::RGBA8;
+    std::vector<TextureFileLevel> levels;
+    // the whole cache file; level offsets index into it
+    std::vector<unsigned char> bytes;
+
+    const unsigned char *LevelData(size_t level) const
+    {
+        return bytes.data() + levels[level].offset;
+    }
+};
+
+// how a source image is turned into TextureData; everything here is part of the cache key
+struct TextureBakeSettings {
+    // encode to BCn (otherwise the levels stay 8-bit uncompressed)
+    bool compress = false;
+    // tangent space normals: compressed to BC5, which keeps only x and y (z has to be reconstructed in the shader)
+    bool normalMap = false;
+    // the driver can sample BC1/BC3 (EXT_texture_compression_s3tc); BC4/BC5 are core
+    bool s3tc = true;
+    // color data in sRGB encoding: mips are averaged in linear light
+    bool srgb = false;
+    // the decoder flips rows (stbi_set_flip_vertically_on_load), i.e. the baked levels are stored bottom row first
+    bool flipVertically = false;
+};
+
+inline uint64_t TextureBakeKey(const std::string &sourcePath, const TextureBakeSettings &settings)
+{
+    uint64_t key = hashString(sourcePath);
+    bool flags[5] = {settings.compress, settings.normalMap, settings.s3tc, settings.srgb, settings.flipVertically};
+    return hashBytes(flags, sizeof(flags), key);
+}
+
+inline std::string TextureCachePathFor(const std::string &sourcePath, const TextureBakeSettings &settings)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.rgtex", (unsigned long long) TextureBakeKey(sourcePath, settings));
+    return cacheDirectory() + "/textures/" + name;
+}
+
+// reads a cache file in one go; fails if it is missing, corrupted or doesn't belong to the given source state and key
+inline bool ReadTextureFile(const std::string &cachePath, const FileStamp &source, uint64_t key, TextureData &data)
+{
+    FILE *in = fopen(cachePath.c_str(), "rb");
+    if (!in)
+        return false;
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    bool ok = size >= (long) sizeof(TextureFileHeader);
+    if (ok)
+    {
+        data.bytes.resize(size);
+        ok = fread(data.bytes.data(), 1, size, in) == (size_t) size;
+    }
+    fclose(in);
+    if (!ok)
+        return false;
+
+    TextureFileHeader header;
+    memcpy(&header, data.bytes.data(), sizeof(header));
+    ok = memcmp(header.magic, TEXTURE_FILE_MAGIC, sizeof(header.magic)) == 0
+         && header.version == TEXTURE_FILE_VERSION
+         && header.format >= (uint32_t) TextureFormat::R8 && header.format <= (uint32_t) TextureFormat::BC5
+         && header.sourceMtime == source.mtime
+         && header.sourceMtimeNsec == source.mtimeNsec
+         && header.sourceSize == source.size
+         && header.key == key
+         && header.levelCount > 0
+         && sizeof(TextureFileHeader) + (uint64_t) header.levelCount * sizeof(TextureFileLevel) <= (uint64_t) size;
+    if (!ok)
+        return false;
+    data.format = (TextureFormat) header.format;
+    data.levels.resize(header.levelCount);
+    memcpy(data.levels.data(), data.bytes.data() + sizeof(header), header.levelCount * sizeof(TextureFileLevel));
+    for (const TextureFileLevel &level : data.levels)
+        if (level.offset > (uint64_t) size || level.size > (uint64_t) size - level.offset)
+            return false;
+    return true;
+}
+
+// builds the file image of a texture whose levels are given as separate buffers, largest first
+inline void AssembleTextureData(TextureFormat format, const std::vector<Image> &mips, const std::vector<std::vector<unsigned char>> &levelBytes,
+                                TextureData &data)
+{
+    data.format = format;
+    data.levels.resize(mips.size());
+    uint64_t offset = sizeof(TextureFileHeader) + mips.size() * sizeof(TextureFileLevel);
+    for (size_t i = 0; i < mips.size(); i++)
+    {
+        offset = (offset + 15) & ~uint64_t(15);
+        data.levels[i].offset = offset;
+        data.levels[i].size = levelBytes[i].size();
+        data.levels[i].width = mips[i].width;
+        data.levels[i].height = mips[i].height;
+        offset += levelBytes[i].size();
+    }
+    data.bytes.assign(offset, 0);
+    memcpy(data.bytes.data() + sizeof(TextureFileHeader), data.levels.data(), mips.size() * sizeof(TextureFileLevel));
+    for (size_t i = 0; i < mips.size(); i++)
+        memcpy(data.bytes.data() + data.levels[i].offset, levelBytes[i].data(), levelBytes[i].size());
+}
+
+inline bool WriteTextureFile(const std::string &cachePath, const FileStamp &source, uint64_t key, TextureData &data)
+{
+    TextureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TEXTURE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TEXTURE_FILE_VERSION;
+    header.format = (uint32_t) data.format;
+    header.width = data.levels[0].width;
+    header.height = data.levels[0].height;
+    header.levelCount = data.levels.size();
+    header.sourceMtime = source.mtime;
+    header.sourceMtimeNsec = source.mtimeNsec;
+    header.sourceSize = source.size;
+    header.key = key;
+    memcpy(data.bytes.data(), &header, sizeof(header));
+
+    if (!createDirectories(cachePath.substr(0, cachePath.find_last_of('/'))))
+        return false;
+    // written under a temporary name and renamed, so a concurrent or crashed writer never leaves a partial file behind
+    std::string tmpPath = cachePath + ".tmp" + std::to_string((unsigned long long) key);
+    FILE *out = fopen(tmpPath.c_str(), "wb");
+    if (!out)
+        return false;
+    bool ok = fwrite(data.bytes.data(), 1, data.bytes.size(), out) == data.bytes.size();
+    ok = fclose(out) == 0 && ok;
+    if (!ok || rename(tmpPath.c_str(), cachePath.c_str()) != 0)
+    {
+        std::cout << "ERROR::TEXTURE_CACHE:: failed to write " << cachePath << std::endl;
+        remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// format the baked levels of an image with the given channel count are stored in
+inline TextureFormat BakedFormat(const Image &image, const TextureBakeSettings &settings)
+{
+    static const TextureFormat uncompressed[4] = {TextureFormat::R8, TextureFormat::RG8, TextureFormat::RGB8, TextureFormat::RGBA8};
+    TextureFormat raw = uncompressed[image.channels - 1];
+    if (!settings.compress)
+        return raw;
+    if (image.channels == 2 || (settings.normalMap && image.channels >= 3))
+        return TextureFormat::BC5;
+    if (image.channels == 1)
+        return TextureFormat::BC4;
+    if (!settings.s3tc)
+        return raw;
+    if (image.channels == 4)
+    {
+        for (size_t i = 3; i < image.pixels.size(); i += 4)
+            if (image.pixels[i] != 255)
+                return TextureFormat::BC3;
+    }
+    return TextureFormat::BC1;
+}
+
+// The texture import stage: returns the baked texture for the image at path, from the cache when it is up to date,
+// otherwise decoding (and flipping), mipmapping and (if requested) compressing it on the CPU and storing the result.
+// Doesn't touch OpenGL, so it can run on a worker thread; block compression itself is spread over the worker pool.
+inline bool LoadTextureData(const std::string &path, const TextureBakeSettings &settings, TextureData &data)
+{
+    FileStamp stamp;
+    if (!getFileStamp(path, stamp))
+        return false;
+    std::string cachePath = TextureCachePathFor(path, settings);
+    uint64_t key = TextureBakeKey(path, settings);
+    if (ReadTextureFile(cachePath, stamp, key, data))
+        return true;
+
+    Image image;
+    unsigned char *pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0);
+    if (!pixels)
+        return false;
+    image.pixels.assign(pixels, pixels + (size_t) image.width * image.height * image.channels);
+    stbi_image_free(pixels);
+
+    TextureFormat format = BakedFormat(image, settings);
+    std::vector<Image> mips = BuildMipChain(image, settings.srgb);
+    std::vector<std::vector<unsigned char>> levelBytes(mips.size());
+    for (size_t i = 0; i < mips.size(); i++)
+    {
+        switch (format)
+        {
+            case TextureFormat::BC1: levelBytes[i] = CompressImage(mips[i], BlockFormat::BC1); break;
+            case TextureFormat::BC3: levelBytes[i] = CompressImage(mips[i], BlockFormat::BC3); break;
+            case TextureFormat::BC4: levelBytes[i] = CompressImage(mips[i], BlockFormat::BC4); break;
+            case TextureFormat::BC5: levelBytes[i] = CompressImage(mips[i], BlockFormat::BC5); break;
+            default: levelBytes[i] = std::move(mips[i].pixels); break;
+        }
+    }
+    AssembleTextureData(format, mips, levelBytes, data);
+    WriteTextureFile(cachePath, stamp, key, data);
+    return true;
+}
+
+// uploads one level into the texture bound to GL_TEXTURE_2D (rows are tightly packed: needs GL_UNPACK_ALIGNMENT 1)
+inline void UploadTextureLevel(const TextureData &data, size_t level)
+{
+    const TextureFileLevel &l = data.levels[level];
+    if (IsCompressed(data.format))
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, GLInternalFormat(data.format), l.width, l.height, 0, l.size, data.LevelData(level));
+    else
+        glTexImage2D(GL_TEXTURE_2D, level, GLInternalFormat(data.format), l.width, l.height, 0, GLPixelFormat(data.format),
+                     GL_UNSIGNED_BYTE, data.LevelData(level));
+}
+
+// makes textureID hold all levels of data, with the same sampling parameters TextureFromFile uses
+inline void UploadTextureData(unsigned int textureID, const TextureData &data)
+{
+    GLint unpackAlignment;
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    GLState::Instance().BindTexture2D(textureID);
+    for (size_t level = 0; level < data.levels.size(); level++)
+        UploadTextureLevel(data, level);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, data.levels.size() - 1);
+}
+#endif
@@ -0,0 +1,389 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/gl_state.h>
+#include <learnopengl/texture_file.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// loads the image at directory/path into a new mipmapped texture, blocking until it is uploaded
+unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma = false);
+
+// Use instead of stbi_set_flip_vertically_on_load: stb_image has no way to ask for the current setting, but baked
+// textures store the flipped rows and have to know whether they did.
+inline bool &flipVerticallyOnLoad()
+{
+    static bool flip = false;
+    return flip;
+}
+
+inline void SetFlipVerticallyOnLoad(bool flip)
+{
+    stbi_set_flip_vertically_on_load(flip);
+    flipVerticallyOnLoad() = flip;
+}
+
+struct TextureLoadOptions {
+    // return a placeholder at once and stream the image in through AsyncTextureLoader
+    bool async = false;
+    bool gamma = false;
+    // go through the texture import stage (LoadTextureData): mip chain filtered and flipped once and then loaded
+    // from the on-disk cache instead of decoding the image and running glGenerateMipmap every time
+    bool baked = false;
+    // also BCn compress the baked levels (implies baked)
+    bool compress = false;
+    // the image is a tangent space normal map (see TextureBakeSettings::normalMap)
+    bool normalMap = false;
+    // the image holds sRGB color (see TextureBakeSettings::srgb)
+    bool srgb = false;
+
+    bool Baked() const
+    {
+        return baked || compress;
+    }
+};
+
+inline TextureBakeSettings BakeSettingsFor(const TextureLoadOptions &options)
+{
+    TextureBakeSettings settings;
+    settings.compress = options.compress;
+    settings.normalMap = options.normalMap;
+    settings.s3tc = GLExtensions::Has("GL_EXT_texture_compression_s3tc");
+    settings.srgb = options.srgb;
+    settings.flipVertically = flipVerticallyOnLoad();
+    return settings;
+}
+
+// loads the image at path through the texture import stage into a new texture, blocking until it is uploaded
+inline unsigned int BakedTextureFromFile(const std::string &path, const TextureBakeSettings &settings)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    TextureData data;
+    if (LoadTextureData(path, settings, data))
+        UploadTextureData(textureID, data);
+    else
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+    return textureID;
+}
+
+// Loads textures without blocking the render thread.
+//
+// Load() creates the texture right away with a 1x1 placeholder and decodes the image on the shared worker pool.
+// Update(), called once per frame on the render thread, streams decoded pixels into the textures through a
+// pixel buffer object a slice of rows at a time until the frame's time budget is used up, so even a scene full
+// of 4K maps never stalls a frame on upload. Baked textures (with their precomputed mip chain) go up a level at a time. Textures keep their id for their whole life; only the contents change.
+class AsyncTextureLoader
+{
+public:
+    // rows uploaded per glTexSubImage2D call are sized to roughly this many bytes
+    static const size_t SLICE_BYTES = 1 << 20;
+
+    static AsyncTextureLoader &Instance()
+    {
+        static AsyncTextureLoader loader;
+        return loader;
+    }
+
+    AsyncTextureLoader(const AsyncTextureLoader&) = delete;
+    AsyncTextureLoader& operator=(const AsyncTextureLoader&) = delete;
+
+    ~AsyncTextureLoader()
+    {
+        // the context is gone by now: only stop the decoders and free the CPU side
+        shared->cancelled = true;
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        for (Image &image : shared->decoded)
+            stbi_image_free(image.pixels);
+        for (Image &image : uploads)
+            stbi_image_free(image.pixels);
+    }
+
+    // returns a usable texture immediately; its contents are replaced once the image at path is decoded and uploaded
+    unsigned int Load(const std::string &path, const TextureLoadOptions &options = TextureLoadOptions())
+    {
+        unsigned int textureID;
+        glGenTextures(1, &textureID);
+        const unsigned char placeholder[4] = {128, 128, 128, 255};
+        GLState::Instance().BindTexture2D(textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // a single level is complete even with a mipmapped filter as long as the chain is capped to it
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+        uint64_t ticket = ++lastTicket;
+        active[textureID] = ticket;
+        std::shared_ptr<Shared> state = shared;
+        bool bake = options.Baked();
+        TextureBakeSettings settings = BakeSettingsFor(options);
+        ThreadPool::Shared().Submit([state, textureID, ticket, path, bake, settings]() {
+            Image image;
+            image.texture = textureID;
+            image.ticket = ticket;
+            image.path = path;
+            image.baked = bake;
+            if (!state->cancelled)
+            {
+                if (bake)
+                    image.loaded = LoadTextureData(path, settings, image.data);
+                else
+                {
+                    image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0);
+                    image.loaded = image.pixels != nullptr;
+                }
+            }
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->cancelled)
+                stbi_image_free(image.pixels);
+            else
+                state->decoded.push_back(image);
+        });
+        return textureID;
+    }
+
+    // uploads decoded images for at most budgetSeconds (but always at least one slice, so loading makes progress)
+    void Update(double budgetSeconds)
+    {
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            for (Image &image : shared->decoded)
+            {
+                // the texture may have been cancelled (and its name even reused) while the image was decoding
+                auto request = active.find(image.texture);
+                if (request != active.end() && request->second == image.ticket)
+                    uploads.push_back(image);
+                else
+                    stbi_image_free(image.pixels);
+            }
+            shared->decoded.clear();
+        }
+        if (uploads.empty())
+            return;
+
+        auto start = std::chrono::steady_clock::now();
+        GLint unpackAlignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (pbo == 0)
+            glGenBuffers(1, &pbo);
+        GLState::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+
+        while (!uploads.empty())
+        {
+            Image &image = uploads.front();
+            if (!image.loaded)
+            {
+                std::cout << "Texture failed to load at path: " << image.path << std::endl;
+                finish();
+                continue;
+            }
+            if (image.baked)
+            {
+                uploadLevel(image);
+                if (image.uploadedLevels == image.data.levels.size())
+                    finish();
+            }
+            else
+            {
+                uploadSlice(image);
+                if (image.uploadedRows == image.height)
+                    finish();
+            }
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() >= budgetSeconds)
+                break;
+        }
+
+        GLState::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+    }
+
+    // stops loading into textureID; must be called before a texture that is still loading gets deleted
+    void Cancel(unsigned int textureID)
+    {
+        if (active.erase(textureID) == 0)
+            return;
+        for (auto it = uploads.begin(); it != uploads.end(); ++it)
+        {
+            if (it->texture == textureID)
+            {
+                stbi_image_free(it->pixels);
+                uploads.erase(it);
+                break;
+            }
+        }
+    }
+
+    // number of textures that still show their placeholder
+    unsigned int Pending() const
+    {
+        return active.size();
+    }
+
+private:
+    struct Image {
+        unsigned int texture = 0;
+        uint64_t ticket = 0;
+        std::string path;
+        bool loaded = false;
+        // decoded image, uploaded in row slices
+        int width = 0, height = 0, channels = 0;
+        unsigned char *pixels = nullptr;
+        int uploadedRows = 0;
+        // or the baked texture, uploaded level by level
+        bool baked = false;
+        TextureData data;
+        size_t uploadedLevels = 0;
+    };
+
+    // state the decode jobs hand their results through; outlives the loader if a job is still running at exit
+    struct Shared {
+        std::mutex mutex;
+        std::vector<Image> decoded;
+        std::atomic<bool> cancelled{false};
+    };
+
+    std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+    std::deque<Image> uploads;
+    // textures still waiting for their image, mapped to the request that will fill them
+    std::unordered_map<unsigned int, uint64_t> active;
+    uint64_t lastTicket = 0;
+    unsigned int pbo = 0;
+
+    AsyncTextureLoader() = default;
+
+    static GLenum formatFor(int channels)
+    {
+        if (channels == 1)
+            return GL_RED;
+        if (channels == 2)
+            return GL_RG;
+        if (channels == 3)
+            return GL_RGB;
+        return GL_RGBA;
+    }
+
+    void uploadSlice(Image &image)
+    {
+        GLenum format = formatFor(image.channels);
+        size_t rowBytes = (size_t) image.width * image.channels;
+        GLState::Instance().BindTexture2D(image.texture);
+        if (image.uploadedRows == 0)
+        {
+            // allocate the full level; with a PBO bound the null pointer would be read as an offset into it
+            GLState::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, nullptr);
+            GLState::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        }
+
+        int rows = std::min<int>(image.height - image.uploadedRows, std::max<size_t>(1, SLICE_BYTES / rowBytes));
+        size_t bytes = rows * rowBytes;
+        // orphan the previous slice's storage so the driver doesn't have to wait for its transfer to finish
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        void *staging = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (staging)
+        {
+            memcpy(staging, image.pixels + image.uploadedRows * rowBytes, bytes);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, image.uploadedRows, image.width, rows, format, GL_UNSIGNED_BYTE, nullptr);
+        }
+        else
+        {
+            // mapping can fail (e.g. out of memory); fall back to a client-memory upload of the slice
+            GLState::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, image.uploadedRows, image.width, rows, format, GL_UNSIGNED_BYTE,
+                            image.pixels + image.uploadedRows * rowBytes);
+            GLState::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        }
+        image.uploadedRows += rows;
+    }
+
+    void uploadLevel(Image &image)
+    {
+        GLState::Instance().BindTexture2D(image.texture);
+        GLState::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        UploadTextureLevel(image.data, image.uploadedLevels++);
+        GLState::Instance().BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    }
+
+    // completes the front upload: builds (or enables) the mip chain and releases the decoded pixels
+    void finish()
+    {
+        Image &image = uploads.front();
+        if (image.loaded && image.baked)
+        {
+            GLState::Instance().BindTexture2D(image.texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.data.levels.size() - 1);
+        }
+        else if (image.pixels)
+        {
+            GLState::Instance().BindTexture2D(image.texture);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 1000);
+            stbi_image_free(image.pixels);
+        }
+        active.erase(image.texture);
+        uploads.pop_front();
+    }
+};
+
+unsigned int TextureFromFile(const char *path, const std::string &directory, bool gamma)
+{
+    std::string filename = std::string(path);
+    filename = directory + '/' + filename;
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    int width, height, nrComponents;
+    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    if (data)
+    {
+        GLenum format;
+        if (nrComponents == 1)
+            format = GL_RED;
+        else if (nrComponents == 3)
+            format = GL_RGB;
+        else if (nrComponents == 4)
+            format = GL_RGBA;
+
+        GLState::Instance().BindTexture2D(textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        stbi_image_free(data);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        stbi_image_free(data);
+    }
+
+    return textureID;
+}
+#endif
@@ -0,0 +1,128 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads for CPU-side loading work (mesh conversion, image decoding, ...).
+// Jobs must never touch OpenGL: the context is only current on the render thread.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount = DefaultThreadCount())
+    {
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this]() { workerLoop(); });
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    // pool shared by all loaders, created on first use
+    static ThreadPool &Shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    static unsigned int DefaultThreadCount()
+    {
+        unsigned int hardware = std::thread::hardware_concurrency();
+        // leave one core for the render thread
+        return hardware > 1 ? hardware - 1 : 1;
+    }
+
+    unsigned int Size() const
+    {
+        return workers.size();
+    }
+
+    // runs job on some worker thread at some point in the future
+    void Submit(std::function<void()> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+        }
+        wakeUp.notify_one();
+    }
+
+    // calls fn(i) for every i in [0, count) and returns once all calls finished.
+    // The calling thread takes part, so this makes progress even when all workers are busy.
+    template<typename Function>
+    void ParallelFor(size_t count, Function fn)
+    {
+        if (count == 0)
+            return;
+        struct Progress {
+            std::atomic<size_t> next{0};
+            std::atomic<size_t> finished{0};
+            std::mutex mutex;
+            std::condition_variable allFinished;
+        };
+        std::shared_ptr<Progress> progress = std::make_shared<Progress>();
+        // helpers that start after everything was claimed only read `progress`, which they keep alive
+        auto run = [progress, count, &fn]() {
+            size_t i;
+            while ((i = progress->next.fetch_add(1)) < count)
+            {
+                fn(i);
+                if (progress->finished.fetch_add(1) + 1 == count)
+                {
+                    std::lock_guard<std::mutex> lock(progress->mutex);
+                    progress->allFinished.notify_all();
+                }
+            }
+        };
+        size_t helpers = std::min<size_t>(workers.size(), count - 1);
+        for (size_t i = 0; i < helpers; i++)
+            Submit(run);
+        run();
+
+        std::unique_lock<std::mutex> lock(progress->mutex);
+        progress->allFinished.wait(lock, [&]() { return progress->finished.load() == count; });
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+};
+#endif
@@ -0,0 +1,113 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/gl_state.h>
+
+#include <cstddef>
+
+// Uniform blocks shared by all programs. GLSL 330 has no layout(binding = N), so every Shader binds the blocks
+// it declares to these points right after linking (BindSharedUniformBlocks); each block's buffer stays bound to
+// its point, so switching programs costs nothing and a frame's data is uploaded once for all of them.
+const GLuint FRAME_DATA_BINDING = 0;
+const GLuint OBJECT_DATA_BINDING = 1;
+const GLuint MATERIAL_DATA_BINDING = 2;
+
+// must match the array size in the shaders' FrameData block
+const int MAX_POINT_LIGHTS = 8;
+
+// std140 mirrors of the GLSL blocks: every member is a vec4 / mat4 or padded to 16 bytes, so the C++ layout is
+// the std140 layout.
+struct PointLightData {
+    glm::vec4 position;    // xyz
+    glm::vec4 ambient;     // rgb
+    glm::vec4 diffuse;     // rgb
+    glm::vec4 specular;    // rgb
+    glm::vec4 attenuation; // constant, linear, quadratic
+};
+
+// written once per frame
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec4 viewPosition; // xyz
+    int lightCount;
+    int padding[3];
+    PointLightData pointLights[MAX_POINT_LIGHTS];
+};
+static_assert(offsetof(FrameData, lightCount) == 144 && offsetof(FrameData, pointLights) == 160, "FrameData must match std140");
+
+// written per drawn object
+struct ObjectData {
+    glm::mat4 model;
+};
+
+// parameters of one Material (learnopengl/material.h); each material has its own buffer, bound with the material
+struct MaterialData {
+    float shininess;
+    float padding[3];
+};
+
+// binds the shared blocks a program declares to their binding points; blocks it doesn't declare are skipped
+inline void BindSharedUniformBlocks(GLuint program)
+{
+    static const struct {
+        const char *name;
+        GLuint binding;
+    } blocks[] = {{"FrameData", FRAME_DATA_BINDING}, {"ObjectData", OBJECT_DATA_BINDING},
+                  {"MaterialData", MATERIAL_DATA_BINDING}};
+    for (const auto &block : blocks)
+    {
+        GLuint index = glGetUniformBlockIndex(program, block.name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, index, block.binding);
+    }
+}
+
+// a uniform buffer holding one T, permanently bound to a binding point
+template<typename T>
+class UniformBuffer
+{
+public:
+    explicit UniformBuffer(GLuint binding) : binding(binding)
+    {
+        glGenBuffers(1, &buffer);
+        GLState::Instance().BindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        GLState::Instance().BindBuffer(GL_UNIFORM_BUFFER, 0);
+        GLState::Instance().BindUniformBufferBase(binding, buffer);
+    }
+
+    ~UniformBuffer()
+    {
+        GLState::Instance().DeleteBuffer(buffer);
+    }
+
+    UniformBuffer(const UniformBuffer &) = delete;
+    UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+    // replaces the whole contents; respecifying the storage lets the driver hand out fresh memory instead of
+    // waiting for draws that still read the previous contents
+    void Update(const T &data)
+    {
+        GLState::Instance().BindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), &data, GL_DYNAMIC_DRAW);
+        GLState::Instance().BindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // points the binding at this buffer again, after another buffer used it
+    void Bind() const
+    {
+        GLState::Instance().BindUniformBufferBase(binding, buffer);
+    }
+
+    GLuint Binding() const { return binding; }
+    unsigned int ID() const { return buffer; }
+
+private:
+    GLuint binding;
+    unsigned int buffer = 0;
+};
+#endif
@@ -0,0 +1,131 @@
+#ifndef UNIFORM_TABLE_H
+#define UNIFORM_TABLE_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// a resolved uniform location of one program; -1 (inactive or unknown uniform) is ignored by glUniform*
+struct UniformHandle {
+    GLint location = -1;
+
+    bool Valid() const { return location >= 0; }
+};
+
+struct UniformUploadStats {
+    // sets skipped because the program already had the value
+    unsigned long long hits = 0;
+    // sets that reached glUniform*
+    unsigned long long misses = 0;
+};
+
+// The active uniforms of a linked program, read once after linking, so setting a uniform by name is a hash lookup
+// instead of a glGetUniformLocation round trip into the driver.
+class UniformTable
+{
+public:
+    void Reflect(GLuint program)
+    {
+        this->program = program;
+        locations.clear();
+        shadows.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> nameBuffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(program, i, (GLsizei) nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+            std::string name(nameBuffer.data(), length);
+            GLint location = glGetUniformLocation(program, name.c_str());
+            // uniforms in blocks have no location
+            if (location < 0)
+                continue;
+            locations[name] = location;
+            // arrays are listed once as "name[0]"; make "name" and every element reachable too
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                locations[base] = location;
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = base + '[' + std::to_string(element) + ']';
+                    locations[elementName] = glGetUniformLocation(program, elementName.c_str());
+                }
+            }
+        }
+    }
+
+    GLint Location(const std::string &name) const
+    {
+        auto found = locations.find(name);
+        if (found != locations.end())
+            return found->second;
+        // a name reflection didn't list (inactive uniform, typo, other spelling): ask the driver once and
+        // remember the answer, -1 included
+        GLint location = glGetUniformLocation(program, name.c_str());
+        locations.emplace(name, location);
+        return location;
+    }
+
+    UniformHandle Handle(const std::string &name) const
+    {
+        UniformHandle handle;
+        handle.location = Location(name);
+        return handle;
+    }
+
+    size_t Size() const { return locations.size(); }
+
+    // Compares value with the shadow copy of what was last uploaded to location and updates the copy.
+    // false: the program already holds this value and the glUniform* call can be skipped.
+    bool Changed(GLint location, const void *value, size_t size) const
+    {
+        // nothing would be uploaded anyway
+        if (location < 0)
+            return false;
+        if (size > sizeof(ShadowValue::bytes))
+        {
+            stats.misses++;
+            return true;
+        }
+        if ((size_t) location >= shadows.size())
+            shadows.resize(location + 1);
+        ShadowValue &shadow = shadows[location];
+        if (shadow.size == size && std::memcmp(shadow.bytes, value, size) == 0)
+        {
+            stats.hits++;
+            return false;
+        }
+        std::memcpy(shadow.bytes, value, size);
+        shadow.size = (unsigned char) size;
+        stats.misses++;
+        return true;
+    }
+
+    // forget the shadow copies, e.g. after uniforms were set behind the table's back
+    void InvalidateShadows() { shadows.clear(); }
+
+    UniformUploadStats Stats() const { return stats; }
+    void ResetStats() { stats = UniformUploadStats(); }
+
+private:
+    // last uploaded value of a location; size 0 = unknown
+    struct ShadowValue {
+        unsigned char size = 0;
+        unsigned char bytes[16 * sizeof(float)];
+    };
+
+    GLuint program = 0;
+    mutable std::unordered_map<std::string, GLint> locations;
+    // indexed by location
+    mutable std::vector<ShadowValue> shadows;
+    mutable UniformUploadStats stats;
+};
+#endif
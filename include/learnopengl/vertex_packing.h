@@ -0,0 +1,130 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// which vertex format a mesh is uploaded in; the CPU copy in Mesh::vertices is always the float Vertex
+enum class VertexLayout {
+    // 56 bytes: float position, normal, uv, tangent and bitangent
+    Standard,
+    // 20 bytes: PackedVertex, decoded by 2.model_lighting.vs with PACKED_VERTICES
+    Packed
+};
+
+// Quantized vertex. Attribute locations match the standard layout, the bitangent is rebuilt in the shader:
+//   0  position  unorm16 x4  xyz relative to the mesh bounds (offset + scale * q), w = bitangent sign (0 = -1, 1 = +1)
+//   1  normal    snorm16 x2  octahedral encoding
+//   2  uv        half x2
+//   3  tangent   snorm16 x2  octahedral encoding
+struct PackedVertex {
+    uint16_t position[4];
+    int16_t normal[2];
+    uint16_t texCoords[2];
+    int16_t tangent[2];
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex is uploaded as is");
+
+namespace vertex_packing {
+
+// IEEE half, round to nearest even; overflow becomes infinity
+inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int) ((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    if (((bits >> 23) & 0xff) == 0xff)
+        return (uint16_t) (sign | 0x7c00 | (mantissa ? 0x200 : 0));
+    if (exponent >= 31)
+        return (uint16_t) (sign | 0x7c00);
+    if (exponent <= 0)
+    {
+        // subnormal half (or zero)
+        if (exponent < -10)
+            return (uint16_t) sign;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return (uint16_t) (sign | half);
+    }
+    uint32_t half = ((uint32_t) exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    // a carry out of the mantissa correctly bumps the exponent
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return (uint16_t) (sign | half);
+}
+
+inline int16_t toSnorm16(float value)
+{
+    return (int16_t) std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+// unit vector -> point on the octahedron, folded into [-1, 1]^2
+inline void octEncode(const glm::vec3 &n, int16_t out[2])
+{
+    float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (l1 == 0.0f)
+    {
+        out[0] = out[1] = 0;
+        return;
+    }
+    float x = n.x / l1, y = n.y / l1;
+    if (n.z < 0.0f)
+    {
+        float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = foldedX;
+        y = foldedY;
+    }
+    out[0] = toSnorm16(x);
+    out[1] = toSnorm16(y);
+}
+
+} // namespace vertex_packing
+
+// the position range a mesh is quantized to: position = offset + scale * q, q in [0, 1]
+struct PositionQuantization {
+    glm::vec3 offset = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+
+    PositionQuantization() = default;
+
+    PositionQuantization(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax) : offset(boundsMin)
+    {
+        scale = boundsMax - boundsMin;
+        // flat along an axis: any scale works, keep it invertible
+        for (int axis = 0; axis < 3; axis++)
+            if (scale[axis] <= 0.0f)
+                scale[axis] = 1.0f;
+    }
+};
+
+inline PackedVertex PackVertex(const glm::vec3 &position, const glm::vec3 &normal, const glm::vec2 &texCoords,
+                               const glm::vec3 &tangent, const glm::vec3 &bitangent, const PositionQuantization &quantization)
+{
+    using namespace vertex_packing;
+    PackedVertex packed;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float q = (position[axis] - quantization.offset[axis]) / quantization.scale[axis];
+        packed.position[axis] = (uint16_t) std::lround(std::min(std::max(q, 0.0f), 1.0f) * 65535.0f);
+    }
+    // the bitangent only needs its handedness: the shader rebuilds it as sign * cross(normal, tangent)
+    packed.position[3] = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? 0 : 65535;
+    octEncode(normal, packed.normal);
+    packed.texCoords[0] = floatToHalf(texCoords.x);
+    packed.texCoords[1] = floatToHalf(texCoords.y);
+    octEncode(tangent, packed.tangent);
+    return packed;
+}
+#endif
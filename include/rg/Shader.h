@@ -12,9 +12,12 @@
 #include <sstream>
 #include <rg/Error.h>
 #include <common.h>
+#include <learnopengl/uniform_table.h>
 #include <glm/glm.hpp>
 class Shader {
     unsigned int m_Id;
+    // active uniforms of the program, reflected after linking
+    UniformTable m_Uniforms;
 public:
     Shader(std::string vertexShaderPath, std::string fragmentShaderPath) {
         appendShaderFolderIfNotPresent(vertexShaderPath);
@@ -65,6 +68,7 @@ public:
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
         m_Id = shaderProgram;
+        m_Uniforms.Reflect(m_Id);
     }
 
     // activate the shader
@@ -73,63 +77,100 @@ public:
     {
         glUseProgram(m_Id);
     }
+    // resolves a uniform name once; the handle is only valid for this shader
+    // ------------------------------------------------------------------------
+    UniformHandle uniform(const std::string &name) const
+    {
+        return m_Uniforms.Handle(name);
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), (int)value);
+        glUniform1i(m_Uniforms.Location(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), value);
+        setInt(m_Uniforms.Handle(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(m_Id, name.c_str()), value);
+        setFloat(m_Uniforms.Handle(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        glUniform2fv(m_Uniforms.Location(name), 1, &value[0]);
     }
     void setVec2(const std::string &name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(m_Id, name.c_str()), x, y);
+        glUniform2f(m_Uniforms.Location(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        setVec3(m_Uniforms.Handle(name), value);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(m_Id, name.c_str()), x, y, z);
+        glUniform3f(m_Uniforms.Location(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        setVec4(m_Uniforms.Handle(name), value);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(m_Id, name.c_str()), x, y, z, w);
+        glUniform4f(m_Uniforms.Location(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(m_Uniforms.Location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(m_Uniforms.Location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(m_Uniforms.Handle(name), mat);
+    }
+    // ------------------------------------------------------------------------
+    // handle setters skip values the program already has (see UniformTable::Changed)
+    void setInt(UniformHandle uniform, int value) const
+    {
+        if (m_Uniforms.Changed(uniform.location, &value, sizeof(int)))
+            glUniform1i(uniform.location, value);
+    }
+    void setFloat(UniformHandle uniform, float value) const
+    {
+        if (m_Uniforms.Changed(uniform.location, &value, sizeof(float)))
+            glUniform1f(uniform.location, value);
+    }
+    void setVec3(UniformHandle uniform, const glm::vec3 &value) const
+    {
+        if (m_Uniforms.Changed(uniform.location, &value[0], 3 * sizeof(float)))
+            glUniform3fv(uniform.location, 1, &value[0]);
+    }
+    void setVec4(UniformHandle uniform, const glm::vec4 &value) const
+    {
+        if (m_Uniforms.Changed(uniform.location, &value[0], 4 * sizeof(float)))
+            glUniform4fv(uniform.location, 1, &value[0]);
+    }
+    void setMat4(UniformHandle uniform, const glm::mat4 &mat) const
+    {
+        if (m_Uniforms.Changed(uniform.location, &mat[0][0], 16 * sizeof(float)))
+            glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    UniformUploadStats uniformStats() const
+    {
+        return m_Uniforms.Stats();
     }
     void deleteProgram() {
         glDeleteProgram(m_Id);
@@ -1,58 +1,90 @@
 #version 330 core
+// variants: HAS_DIFFUSE_MAP, HAS_SPECULAR_MAP, HAS_NORMAL_MAP (learnopengl/shader_variants.h)
 out vec4 FragColor;
 
 struct PointLight {
-    vec3 position;
-
-    vec3 specular;
-    vec3 diffuse;
-    vec3 ambient;
+    vec4 position;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 attenuation; // constant, linear, quadratic
+};
 
-    float constant;
-    float linear;
-    float quadratic;
+// per frame, shared by all programs (learnopengl/uniform_buffer.h)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPosition;
+    int lightCount;
+    PointLight pointLights[8];
 };
 
-struct Material {
-    sampler2D texture_diffuse1;
-    sampler2D texture_specular1;
+// the textures of a Material; every sampler is set to its slot's unit at link time (learnopengl/material.h)
+#ifdef HAS_DIFFUSE_MAP
+uniform sampler2D texture_diffuse1;
+#endif
+#ifdef HAS_SPECULAR_MAP
+uniform sampler2D texture_specular1;
+#endif
+#ifdef HAS_NORMAL_MAP
+uniform sampler2D texture_normal1;
+#endif
 
+// the parameters of the Material being drawn
+layout (std140) uniform MaterialData {
     float shininess;
 };
 in vec2 TexCoords;
 in vec3 Normal;
 in vec3 FragPos;
+#ifdef HAS_NORMAL_MAP
+in mat3 TBN;
+#endif
 
-uniform PointLight pointLight;
-uniform Material material;
-
-uniform vec3 viewPosition;
 // calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 albedo, float specularMask)
 {
-    vec3 lightDir = normalize(light.position - fragPos);
+    vec3 lightDir = normalize(light.position.xyz - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
-    // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // attenuation
-    float distance = length(light.position - fragPos);
-    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+    float distance = length(light.position.xyz - fragPos);
+    float attenuation = 1.0 / (light.attenuation.x + light.attenuation.y * distance + light.attenuation.z * (distance * distance));
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.texture_diffuse1, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.texture_specular1, TexCoords).xxx);
-    ambient *= attenuation;
-    diffuse *= attenuation;
-    specular *= attenuation;
-    return (ambient + diffuse + specular);
+    vec3 ambient = light.ambient.rgb * albedo;
+    vec3 diffuse = light.diffuse.rgb * diff * albedo;
+    vec3 result = (ambient + diffuse) * attenuation;
+#ifdef HAS_SPECULAR_MAP
+    // specular shading
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    result += light.specular.rgb * spec * specularMask * attenuation;
+#endif
+    return result;
 }
 
 void main()
 {
+#ifdef HAS_NORMAL_MAP
+    // two channel (BC5) normal maps: z is reconstructed from xy
+    vec2 xy = texture(texture_normal1, TexCoords).rg * 2.0 - 1.0;
+    vec3 normal = normalize(TBN * vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0))));
+#else
     vec3 normal = normalize(Normal);
-    vec3 viewDir = normalize(viewPosition - FragPos);
-    vec3 result = CalcPointLight(pointLight, normal, FragPos, viewDir);
+#endif
+#ifdef HAS_DIFFUSE_MAP
+    vec3 albedo = texture(texture_diffuse1, TexCoords).rgb;
+#else
+    vec3 albedo = vec3(1.0);
+#endif
+#ifdef HAS_SPECULAR_MAP
+    float specularMask = texture(texture_specular1, TexCoords).r;
+#else
+    float specularMask = 0.0;
+#endif
+    vec3 viewDir = normalize(viewPosition.xyz - FragPos);
+    vec3 result = vec3(0.0);
+    for (int i = 0; i < lightCount; i++)
+        result += CalcPointLight(pointLights[i], normal, FragPos, viewDir, albedo, specularMask);
     FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+}
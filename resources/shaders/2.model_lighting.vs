@@ -1,20 +1,105 @@
 #version 330 core
+// variants: PACKED_VERTICES, HAS_NORMAL_MAP, INSTANCED (learnopengl/shader_variants.h)
+#ifdef PACKED_VERTICES
+// PackedVertex layout (see learnopengl/vertex_packing.h)
+layout (location = 0) in vec4 aPos;      // unorm16: xyz in the mesh bounds, w = bitangent sign
+layout (location = 1) in vec2 aNormal;   // octahedral
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec2 aTangent;  // octahedral
+#else
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec3 aBitangent;
+#endif
+#ifdef INSTANCED
+// first three rows of the instance's model matrix (learnopengl/instance_buffer.h)
+layout (location = 5) in vec4 aInstanceRow0;
+layout (location = 6) in vec4 aInstanceRow1;
+layout (location = 7) in vec4 aInstanceRow2;
+#endif
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+#ifdef HAS_NORMAL_MAP
+out mat3 TBN;
+#endif
+
+struct PointLight {
+    vec4 position;
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    vec4 attenuation; // constant, linear, quadratic
+};
+
+// per frame, shared by all programs (learnopengl/uniform_buffer.h)
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    vec4 viewPosition;
+    int lightCount;
+    PointLight pointLights[8];
+};
+
+layout (std140) uniform ObjectData {
+    mat4 model;
+};
+
+#ifdef PACKED_VERTICES
+// dequantization of aPos.xyz: offset + scale * aPos.xyz
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+vec3 octDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// for normal mapping: tangent = octDecode(aTangent), bitangent = bitangentSign() * cross(normal, tangent)
+float bitangentSign()
+{
+    return aPos.w > 0.5 ? 1.0 : -1.0;
+}
+#endif
+
+mat4 modelMatrix()
+{
+#ifdef INSTANCED
+    return transpose(mat4(aInstanceRow0, aInstanceRow1, aInstanceRow2, vec4(0.0, 0.0, 0.0, 1.0)));
+#else
+    return model;
+#endif
+}
 
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = aNormal;
-    TexCoords = aTexCoords;    
+#ifdef PACKED_VERTICES
+    vec3 position = positionOffset + positionScale * aPos.xyz;
+    vec3 normal = octDecode(aNormal);
+#else
+    vec3 position = aPos;
+    vec3 normal = aNormal;
+#endif
+    FragPos = vec3(modelMatrix() * vec4(position, 1.0));
+    Normal = normal;
+    TexCoords = aTexCoords;
+#ifdef HAS_NORMAL_MAP
+    // tangent space -> the space Normal is in
+#ifdef PACKED_VERTICES
+    vec3 tangent = octDecode(aTangent);
+    vec3 bitangent = bitangentSign() * cross(normal, tangent);
+#else
+    vec3 tangent = aTangent;
+    vec3 bitangent = aBitangent;
+#endif
+    TBN = mat3(normalize(tangent), normalize(bitangent), normalize(normal));
+#endif
     gl_Position = projection * view * vec4(FragPos, 1.0);
-}
\ No newline at end of file
+}
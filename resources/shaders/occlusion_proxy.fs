@@ -0,0 +1,8 @@
+#version 330 core
+// only the depth test matters: color writes are masked while proxies are drawn
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(1.0);
+}
@@ -0,0 +1,12 @@
+#version 330 core
+// bounding box proxies for GPU occlusion queries (learnopengl/occlusion_queries.h)
+layout (location = 0) in vec3 aPos; // unit cube corner
+
+uniform mat4 projView;
+uniform vec3 boxMin;
+uniform vec3 boxSize;
+
+void main()
+{
+    gl_Position = projView * vec4(boxMin + boxSize * aPos, 1.0);
+}
@@ -13,8 +13,15 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/bvh_benchmark.h>
+#include <learnopengl/occlusion_benchmark.h>
+#include <learnopengl/scene.h>
 
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -29,6 +36,8 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// distance from the camera to the corners of its near plane (0.1, at most 45 degrees of zoom), rounded up
+const float OCCLUSION_NEAR_MARGIN = 0.2f;
 
 // camera
 
@@ -51,6 +60,17 @@ struct PointLight {
     float quadratic;
 };
 
+// the light as laid out in the FrameData uniform block
+PointLightData ToPointLightData(const PointLight &light) {
+    PointLightData data;
+    data.position = glm::vec4(light.position, 1.0f);
+    data.ambient = glm::vec4(light.ambient, 0.0f);
+    data.diffuse = glm::vec4(light.diffuse, 0.0f);
+    data.specular = glm::vec4(light.specular, 0.0f);
+    data.attenuation = glm::vec4(light.constant, light.linear, light.quadratic, 0.0f);
+    return data;
+}
+
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
     bool ImGuiEnabled = false;
@@ -58,7 +78,33 @@ struct ProgramState {
     bool CameraMouseMovementUpdateEnabled = true;
     glm::vec3 backpackPosition = glm::vec3(0.0f);
     float backpackScale = 1.0f;
+    // more than one: a grid of backpacks drawn with DrawInstanced
+    int backpackCount = 1;
     PointLight pointLight;
+    // uniform sets of the last frame: skipped because unchanged / sent to GL
+    UniformUploadStats uniformStats;
+    // draws and state changes of the last frame
+    RenderQueueStats renderStats;
+    // shader variants still being compiled by the driver
+    size_t shadersCompiling = 0;
+    // binds and enables of the last frame, and how many GLState dropped as redundant
+    GLStateStats glStateStats;
+    // test meshes and instances against the view frustum before drawing them
+    bool frustumCulling = true;
+    // bounds tested and culled in the last frame
+    CullStats cullStats;
+    // the backpack of the grid in the middle of the screen, -1 for none
+    int lookedAtBackpack = -1;
+    // hide backpacks of the grid behind the nearest ones (CPU depth buffer, see OccludeInstances)
+    bool occlusionCulling = true;
+    OcclusionStats occlusionStats;
+    // GPU occlusion queries on the bounding boxes of the backpacks of the grid, or of the single backpack's meshes
+    bool occlusionQueries = false;
+    OcclusionQueryStats occlusionQueryStats;
+    // draw simplified LODs of the backpack where their error projects to less than lodPixels
+    bool lodSelection = true;
+    float lodPixels = 1.0f;
+    LODStats lodStats;
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
 
@@ -101,7 +147,50 @@ ProgramState *programState;
 
 void DrawImGui(ProgramState *programState);
 
-int main() {
+void OccludeInstances(OcclusionCuller &occlusion, const OccluderMesh &occluder, const Model &model,
+                      const glm::vec3 &viewPosition, const std::vector<glm::mat4> &transforms,
+                      std::vector<uint32_t> &instances);
+
+bool ParseCount(const char *text, size_t &value);
+
+int main(int argc, char **argv) {
+    // --bvh-benchmark [instances...]: time the scene BVH on the CPU and exit, without opening a window
+    if (argc > 1 && std::string(argv[1]) == "--bvh-benchmark") {
+        std::vector<size_t> instanceCounts;
+        for (int i = 2; i < argc; i++) {
+            size_t count;
+            if (!ParseCount(argv[i], count)) {
+                std::cout << "usage: " << argv[0] << " --bvh-benchmark [instances...]" << std::endl;
+                return -1;
+            }
+            instanceCounts.push_back(count);
+        }
+        if (instanceCounts.empty())
+            instanceCounts = {10000, 100000, 1000000};
+        RunBVHBenchmark(instanceCounts);
+        return 0;
+    }
+    // --occlusion-benchmark [width height [boxes]]: time the software occlusion culler and exit
+    if (argc > 1 && std::string(argv[1]) == "--occlusion-benchmark") {
+        size_t width = 256, height = 128, boxes = 100000;
+        const size_t MAX_SIZE = 8192;
+        bool valid = argc <= 5 && argc != 3;
+        if (valid && argc > 3)
+            valid = ParseCount(argv[2], width) && ParseCount(argv[3], height) && width > 0 && height > 0 &&
+                    width <= MAX_SIZE && height <= MAX_SIZE;
+        if (valid && argc > 4)
+            valid = ParseCount(argv[4], boxes);
+        if (!valid) {
+            std::cout << "usage: " << argv[0] << " --occlusion-benchmark [width height [boxes]]" << std::endl;
+            return -1;
+        }
+        RunOcclusionBenchmark((int) width, (int) height, boxes);
+        return 0;
+    }
+    // --occlusion-check: headless checks that the software occlusion culler culls what it should and nothing more
+    if (argc > 1 && std::string(argv[1]) == "--occlusion-check")
+        return RunOcclusionCheck() ? 0 : 1;
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -135,9 +224,11 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // newer entry points (program binaries, ...) the driver may offer beyond 3.3
+    GLExtensions::Load((GLADloadproc) glfwGetProcAddress);
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
-    stbi_set_flip_vertically_on_load(true);
+    SetFlipVerticallyOnLoad(true);
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
@@ -157,91 +248,242 @@ int main() {
 
     // configure global opengl state
     // -----------------------------
-    glEnable(GL_DEPTH_TEST);
-
-    // build and compile shaders
-    // -------------------------
-    Shader ourShader("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
-
-    // load models
-    // -----------
-    Model ourModel("resources/objects/backpack/backpack.obj");
-    ourModel.SetShaderTextureNamePrefix("material.");
-
-    PointLight& pointLight = programState->pointLight;
-    pointLight.position = glm::vec3(4.0f, 4.0, 0.0);
-    pointLight.ambient = glm::vec3(0.1, 0.1, 0.1);
-    pointLight.diffuse = glm::vec3(0.6, 0.6, 0.6);
-    pointLight.specular = glm::vec3(1.0, 1.0, 1.0);
-
-    pointLight.constant = 1.0f;
-    pointLight.linear = 0.09f;
-    pointLight.quadratic = 0.032f;
-
-
-
-    // draw in wireframe
-    //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-
-    // render loop
-    // -----------
-    while (!glfwWindowShouldClose(window)) {
-        // per-frame time logic
-        // --------------------
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        // input
-        // -----
-        processInput(window);
-
-
-        // render
-        // ------
-        glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        // don't forget to enable shader before setting uniforms
-        ourShader.use();
-        pointLight.position = glm::vec3(4.0 * cos(currentFrame), 4.0f, 4.0 * sin(currentFrame));
-        ourShader.setVec3("pointLight.position", pointLight.position);
-        ourShader.setVec3("pointLight.ambient", pointLight.ambient);
-        ourShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        ourShader.setVec3("pointLight.specular", pointLight.specular);
-        ourShader.setFloat("pointLight.constant", pointLight.constant);
-        ourShader.setFloat("pointLight.linear", pointLight.linear);
-        ourShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-        ourShader.setVec3("viewPosition", programState->camera.Position);
-        ourShader.setFloat("material.shininess", 32.0f);
-        // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
-                                                (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-        // render the loaded model
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model,
-                               programState->backpackPosition); // translate it down so it's at the center of the scene
-        model = glm::scale(model, glm::vec3(programState->backpackScale));    // it's a bit too big for our scene, so scale it down
-        ourShader.setMat4("model", model);
-        ourModel.Draw(ourShader);
-
-        if (programState->ImGuiEnabled)
-            DrawImGui(programState);
-
-
-
-        // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-        // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    GLState::Instance().Enable(GL_DEPTH_TEST);
+
+    // everything below that owns GL objects lives in this scope, so it is deleted while the context is current
+    {
+        // build and compile shaders
+        // -------------------------
+        // one program per combination of vertex layout and texture set actually drawn (learnopengl/shader_variants.h)
+        ShaderVariants lighting("resources/shaders/2.model_lighting.vs", "resources/shaders/2.model_lighting.fs");
+        // submitted before the model loads, so the driver compiles them while the model is imported: the fully
+        // textured variant and the untextured one meshes fall back to until theirs is ready
+        const uint32_t layoutFeatures = SHADER_PACKED_VERTICES;
+        lighting.Prepare(layoutFeatures);
+        lighting.Prepare(layoutFeatures | SHADER_DIFFUSE_MAP | SHADER_SPECULAR_MAP | SHADER_NORMAL_MAP);
+        // per-frame and per-object data go through uniform blocks every program shares
+        UniformBuffer<FrameData> frameUniforms(FRAME_DATA_BINDING);
+        UniformBuffer<ObjectData> objectUniforms(OBJECT_DATA_BINDING);
+        // every frame's draws go through the queue, sorted by state and merged into multi-draws
+        RenderQueue renderQueue;
+        renderQueue.SetBatching(true);
+        FrustumCuller frustumCuller;
+        std::vector<glm::mat4> instanceTransforms, visibleTransforms;
+        std::vector<uint32_t> visibleInstances, testedInstances;
+        // ids are the single backpack's mesh indices and the grid's instance indices (into instanceTransforms, so
+        // frustum culling doesn't shift them; the grid's queries are reset when it changes)
+        OcclusionQueries meshQueries, instanceQueries;
+        // ids are mesh and instance indices again, the grid's LODs are reset with its queries
+        LODSelector meshLODs, instanceLODs;
+        std::vector<unsigned int> visibleLevels;
+
+        // load models
+        // -----------
+        ModelImportOptions importOptions;
+        importOptions.asyncTextures = true;
+        importOptions.bakeTextures = true;
+        importOptions.compressTextures = true;
+        importOptions.optimizeMeshes = true;
+        importOptions.vertexLayout = VertexLayout::Packed;
+        importOptions.shareGeometry = true;
+        importOptions.generateLODs = true;
+        Model ourModel("resources/objects/backpack/backpack.obj", false, importOptions);
+        // the remaining variants the model needs; meshes draw with a fallback until they are ready
+        for (const Mesh &mesh : ourModel.meshes)
+            lighting.Prepare(mesh.ShaderFeatures());
+        // the copies of the backpack when there is more than one, culled and picked through a BVH
+        InstanceScene backpacks(ourModel.Bounds());
+        // what a backpack hides of the ones behind it
+        OccluderMesh backpackOccluder = ourModel.MakeOccluder(256);
+        OcclusionCuller occlusion;
+
+        PointLight& pointLight = programState->pointLight;
+        pointLight.position = glm::vec3(4.0f, 4.0, 0.0);
+        pointLight.ambient = glm::vec3(0.1, 0.1, 0.1);
+        pointLight.diffuse = glm::vec3(0.6, 0.6, 0.6);
+        pointLight.specular = glm::vec3(1.0, 1.0, 1.0);
+
+        pointLight.constant = 1.0f;
+        pointLight.linear = 0.09f;
+        pointLight.quadratic = 0.032f;
+
+
+
+        // draw in wireframe
+        //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+
+        // render loop
+        // -----------
+        while (!glfwWindowShouldClose(window)) {
+            // per-frame time logic
+            // --------------------
+            float currentFrame = glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
+
+            // input
+            // -----
+            processInput(window);
+
+            // stream in textures that finished decoding, without spending more than a few ms of the frame on it
+            AsyncTextureLoader::Instance().Update(0.002);
+
+
+            // render
+            // ------
+            glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // don't forget to enable shader before setting uniforms
+            pointLight.position = glm::vec3(4.0 * cos(currentFrame), 4.0f, 4.0 * sin(currentFrame));
+            // view/projection transformations
+            glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
+                                                    (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
+            glm::mat4 view = programState->camera.GetViewMatrix();
+            FrameData frame{};
+            frame.view = view;
+            frame.projection = projection;
+            frame.viewPosition = glm::vec4(programState->camera.Position, 1.0f);
+            frame.lightCount = 1;
+            frame.pointLights[0] = ToPointLightData(pointLight);
+            frameUniforms.Update(frame);
+            frustumCuller.SetFrustum(Frustum(projection * view));
+            FrustumCuller *culler = programState->frustumCulling ? &frustumCuller : nullptr;
+
+            // render the loaded model
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model,
+                                   programState->backpackPosition); // translate it down so it's at the center of the scene
+            model = glm::scale(model, glm::vec3(programState->backpackScale));    // it's a bit too big for our scene, so scale it down
+            CullStats instanceCulling;
+            if (programState->backpackCount > 1)
+            {
+                // a square grid of copies around the backpack, one instanced draw per mesh
+                int columns = (int) std::ceil(std::sqrt((float) programState->backpackCount));
+                float spacing = 4.0f * programState->backpackScale;
+                instanceTransforms.clear();
+                for (int i = 0; i < programState->backpackCount; i++)
+                {
+                    glm::vec3 offset((i % columns) * spacing, 0.0f, -(i / columns) * spacing);
+                    instanceTransforms.push_back(glm::translate(glm::mat4(1.0f), offset) * model);
+                }
+                // an index may be another backpack now: its results would hide the wrong one, and its LOD would hold
+                // the wrong one's level
+                if (backpacks.SetTransforms(instanceTransforms))
+                {
+                    instanceQueries.Reset();
+                    instanceLODs.Reset();
+                }
+                if (culler)
+                {
+                    backpacks.Visible(frustumCuller.CurrentFrustum(), visibleInstances);
+                    instanceCulling.tested = instanceTransforms.size();
+                    instanceCulling.culled = instanceTransforms.size() - visibleInstances.size();
+                }
+                else
+                {
+                    visibleInstances.resize(instanceTransforms.size());
+                    for (uint32_t i = 0; i < visibleInstances.size(); i++)
+                        visibleInstances[i] = i;
+                }
+                programState->occlusionStats = OcclusionStats();
+                if (programState->occlusionCulling)
+                {
+                    occlusion.Begin(projection * view);
+                    OccludeInstances(occlusion, backpackOccluder, ourModel, programState->camera.Position,
+                                     instanceTransforms, visibleInstances);
+                    programState->occlusionStats = occlusion.Stats();
+                }
+                // the queries test every candidate after the frame is drawn, the ones they found hidden are left out of it
+                testedInstances = visibleInstances;
+                if (programState->occlusionQueries)
+                {
+                    instanceQueries.NewFrame();
+                    visibleInstances.erase(std::remove_if(visibleInstances.begin(), visibleInstances.end(),
+                                                          [&](uint32_t instance) { return !instanceQueries.Visible(instance); }),
+                                           visibleInstances.end());
+                }
+                visibleTransforms.clear();
+                for (uint32_t instance : visibleInstances)
+                    visibleTransforms.push_back(instanceTransforms[instance]);
+                programState->lodStats = LODStats();
+                if (programState->lodSelection)
+                {
+                    instanceLODs.SetThreshold(programState->lodPixels);
+                    instanceLODs.SetView(programState->camera.Zoom, (float) SCR_HEIGHT, programState->camera.Position);
+                    visibleLevels.clear();
+                    for (uint32_t instance : visibleInstances)
+                        visibleLevels.push_back(ourModel.SelectLOD(instanceLODs, instance, instanceTransforms[instance]));
+                    programState->lodStats = instanceLODs.Stats();
+                }
+                ourModel.DrawInstanced(lighting, visibleTransforms, nullptr, programState->lodSelection ? &visibleLevels : nullptr);
+                if (programState->occlusionQueries)
+                {
+                    instanceQueries.BeginProxies(projection * view, programState->camera.Position, OCCLUSION_NEAR_MARGIN);
+                    for (uint32_t instance : testedInstances)
+                        instanceQueries.Test(instance, ourModel.Bounds().box.Transformed(instanceTransforms[instance]));
+                    instanceQueries.EndProxies();
+                    programState->occlusionQueryStats = instanceQueries.Stats();
+                }
+                Ray gaze;
+                gaze.origin = programState->camera.Position;
+                gaze.direction = programState->camera.Front;
+                programState->lookedAtBackpack = backpacks.Pick(gaze);
+                programState->renderStats = RenderQueueStats();
+            }
+            else
+            {
+                OcclusionQueries *queries = programState->occlusionQueries ? &meshQueries : nullptr;
+                if (queries)
+                    queries->NewFrame();
+                LODSelector *lods = programState->lodSelection ? &meshLODs : nullptr;
+                if (lods)
+                {
+                    lods->SetThreshold(programState->lodPixels);
+                    lods->SetView(programState->camera.Zoom, (float) SCR_HEIGHT, programState->camera.Position);
+                }
+                ourModel.Enqueue(renderQueue, lighting, model, programState->camera.Position, culler, queries, lods);
+                programState->lodStats = lods ? lods->Stats() : LODStats();
+                renderQueue.SetStatsEnabled(programState->ImGuiEnabled);
+                renderQueue.Submit(objectUniforms);
+                programState->renderStats = renderQueue.Stats();
+                if (queries)
+                {
+                    queries->BeginProxies(projection * view, programState->camera.Position, OCCLUSION_NEAR_MARGIN);
+                    ourModel.TestOcclusion(*queries, model);
+                    queries->EndProxies();
+                    programState->occlusionQueryStats = queries->Stats();
+                }
+            }
+
+            programState->uniformStats = lighting.UniformStats();
+            lighting.ResetUniformStats();
+            programState->shadersCompiling = lighting.Poll();
+            programState->glStateStats = GLState::Instance().Stats();
+            programState->cullStats = frustumCuller.Stats();
+            programState->cullStats.tested += instanceCulling.tested;
+            programState->cullStats.culled += instanceCulling.culled;
+            frustumCuller.ResetStats();
+            GLState::Instance().ResetStats();
+
+            if (programState->ImGuiEnabled)
+                DrawImGui(programState);
+
+
+
+            // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+            // -------------------------------------------------------------------------------
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        // the backpack's references to the TextureCache: its textures are deleted (or their loads cancelled) here
+        ourModel.ReleaseTextures();
     }
 
     programState->SaveToFile("resources/program_state.txt");
     delete programState;
+    // the meshes' shared geometry, while the context is still there
+    Mesh::ReleaseSharedArenas();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -314,10 +556,46 @@ void DrawImGui(ProgramState *programState) {
         ImGui::ColorEdit3("Background color", (float *) &programState->clearColor);
         ImGui::DragFloat3("Backpack position", (float*)&programState->backpackPosition);
         ImGui::DragFloat("Backpack scale", &programState->backpackScale, 0.05, 0.1, 4.0);
+        ImGui::DragInt("Backpack count", &programState->backpackCount, 1.0f, 1, 65536);
 
         ImGui::DragFloat("pointLight.constant", &programState->pointLight.constant, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.linear", &programState->pointLight.linear, 0.05, 0.0, 1.0);
         ImGui::DragFloat("pointLight.quadratic", &programState->pointLight.quadratic, 0.05, 0.0, 1.0);
+        ImGui::Text("Textures loading: %u", AsyncTextureLoader::Instance().Pending());
+        const RenderQueueStats &draws = programState->renderStats;
+        ImGui::Text("Draws: %zu, programs %zu (%zu unsorted), materials %zu (%zu), VAOs %zu (%zu)", draws.draws,
+                    draws.programChanges, draws.unsortedProgramChanges, draws.materialChanges, draws.unsortedMaterialChanges,
+                    draws.vaoChanges, draws.unsortedVaoChanges);
+        ImGui::Text("Draw calls: %zu (%zu multi-draws)", draws.drawCalls, draws.multiDraws);
+        ImGui::Text("Shaders compiling: %zu", programState->shadersCompiling);
+        ImGui::Text("Uniforms: %llu skipped, %llu sent", programState->uniformStats.hits, programState->uniformStats.misses);
+        ImGui::Text("GL state: %llu of %llu calls filtered", programState->glStateStats.filtered,
+                    programState->glStateStats.calls);
+        ImGui::Checkbox("Frustum culling", &programState->frustumCulling);
+        ImGui::Text("Culling: %zu drawn, %zu culled", programState->cullStats.Visible(), programState->cullStats.culled);
+        if (programState->backpackCount > 1)
+        {
+            ImGui::Text("Looking at backpack: %d", programState->lookedAtBackpack);
+            ImGui::Checkbox("Occlusion culling", &programState->occlusionCulling);
+            const OcclusionStats &occlusionStats = programState->occlusionStats;
+            ImGui::Text("Occlusion: %zu of %zu hidden, %zu occluder triangles", occlusionStats.occluded,
+                        occlusionStats.tested, occlusionStats.rasterizedTriangles);
+        }
+        ImGui::Checkbox("LOD selection", &programState->lodSelection);
+        if (programState->lodSelection)
+        {
+            ImGui::DragFloat("LOD error (pixels)", &programState->lodPixels, 0.05f, 0.25f, 16.0f);
+            const LODStats &lodStats = programState->lodStats;
+            ImGui::Text("LOD: %zu of %zu triangles, %zu switches", lodStats.triangles, lodStats.fullTriangles,
+                        lodStats.switches);
+        }
+        ImGui::Checkbox("GPU occlusion queries", &programState->occlusionQueries);
+        if (programState->occlusionQueries)
+        {
+            const OcclusionQueryStats &queryStats = programState->occlusionQueryStats;
+            ImGui::Text("Queries: %zu issued, %zu hidden, %zu conditional draws", queryStats.issued, queryStats.hidden,
+                        queryStats.conditional);
+        }
         ImGui::End();
     }
 
@@ -333,6 +611,8 @@ void DrawImGui(ProgramState *programState) {
 
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    // the ImGui renderer sets GL state behind GLState's back
+    GLState::Instance().Invalidate();
 }
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods) {
@@ -346,3 +626,40 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
         }
     }
 }
+
+// removes the instances hidden behind the ones nearest to viewPosition, which are drawn into the occlusion culler's
+// depth buffer as occluders. Begin has to have been called for the frame.
+void OccludeInstances(OcclusionCuller &occlusion, const OccluderMesh &occluder, const Model &model,
+                      const glm::vec3 &viewPosition, const std::vector<glm::mat4> &transforms,
+                      std::vector<uint32_t> &instances) {
+    const size_t OCCLUDER_COUNT = 16;
+    if (model.Bounds().Empty())
+        return;
+    std::vector<std::pair<float, uint32_t>> byDistance(instances.size());
+    for (size_t i = 0; i < instances.size(); i++)
+        byDistance[i] = {glm::length(glm::vec3(transforms[instances[i]][3]) - viewPosition), instances[i]};
+    size_t occluders = std::min(OCCLUDER_COUNT, byDistance.size());
+    std::partial_sort(byDistance.begin(), byDistance.begin() + occluders, byDistance.end());
+    for (size_t i = 0; i < occluders; i++)
+        occlusion.AddOccluder(occluder, transforms[byDistance[i].second]);
+    occlusion.Rasterize();
+
+    size_t kept = 0;
+    for (uint32_t instance : instances)
+        if (occlusion.IsVisible(model.Bounds().box.Transformed(transforms[instance])))
+            instances[kept++] = instance;
+    instances.resize(kept);
+}
+
+// a whole decimal number, nothing else; false for anything strtoull would have to guess at
+bool ParseCount(const char *text, size_t &value) {
+    if (!std::isdigit((unsigned char) text[0]))
+        return false;
+    char *end = nullptr;
+    errno = 0;
+    unsigned long long parsed = std::strtoull(text, &end, 10);
+    if (errno == ERANGE || *end != '\0' || parsed > std::numeric_limits<size_t>::max())
+        return false;
+    value = (size_t) parsed;
+    return true;
+}